@@ -1,88 +1,255 @@
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "interrupts.h"
 #include "alarm.h"
 #include "minithread.h"
-#include "queue.h"
+#include "timing_wheel.h"
 
-queue_t alarm_queue;
-int gen_alarm_id;
+/*
+ * Alarms live in a slab of fixed-size slots that grows a chunk at a time and
+ * is never returned to the allocator. An alarm id is the slot index in the low
+ * ALARM_INDEX_BITS bits and the slot's generation above it, so deregister_alarm
+ * indexes straight into the slot and a stale id (the slot has since been freed
+ * and reused) fails the generation check.
+ */
+#define ALARM_INDEX_BITS 16
+#define ALARM_MAX_SLOTS (1 << ALARM_INDEX_BITS)
+#define ALARM_GENERATION_MASK 0x7fff
+#define ALARM_SLAB_CHUNK 64
+
+timing_wheel_t alarm_wheel;
+long alarm_deadline; // no alarm fires before this tick, -1 if none is pending
 
 struct alarm_item {
-    int alarm_id;
+    int alarm_id; // -1 while the slot is free
+	int generation;
 	long delay;
     proc_t alarm_func;
 	arg_t alarm_func_arg;
+	struct timing_wheel_entry entry;
+	int next_free; // index of the next free slot
 };
 
+alarm_item_t alarm_slab[ALARM_MAX_SLOTS / ALARM_SLAB_CHUNK];
+int alarm_slots; // slots carved out of the slab so far
+int alarm_free_slot; // head of the free slot list, -1 if empty
+
+static alarm_item_t
+alarm_slot(int index) {
+	return &alarm_slab[index / ALARM_SLAB_CHUNK][index % ALARM_SLAB_CHUNK];
+}
+
 /*
- * insert alarm event into the alarm queue
+ * Take a free slot, growing the slab by a chunk if none is left.
+ * Must be called with interrupts disabled. Returns NULL on failure.
+ */
+static alarm_item_t
+alarm_slot_alloc() {
+	alarm_item_t alarm;
+	int index, i;
+
+	if (alarm_free_slot == -1) {
+		if (alarm_slots == ALARM_MAX_SLOTS) {
+			return NULL;
+		}
+		alarm = (alarm_item_t)malloc(ALARM_SLAB_CHUNK * sizeof(struct alarm_item));
+		if (alarm == NULL) {
+			return NULL;
+		}
+		alarm_slab[alarm_slots / ALARM_SLAB_CHUNK] = alarm;
+		for (i = 0; i < ALARM_SLAB_CHUNK; i++) {
+			alarm[i].alarm_id = -1;
+			alarm[i].generation = 0;
+			alarm[i].next_free = i + 1 < ALARM_SLAB_CHUNK ? alarm_slots + i + 1 : -1;
+		}
+		alarm_free_slot = alarm_slots;
+		alarm_slots += ALARM_SLAB_CHUNK;
+	}
+	index = alarm_free_slot;
+	alarm = alarm_slot(index);
+	alarm_free_slot = alarm -> next_free;
+	alarm -> alarm_id = (alarm -> generation << ALARM_INDEX_BITS) | index;
+	return alarm;
+}
+
+/*
+ * Return a slot to the free list, retiring its id.
+ * Must be called with interrupts disabled.
+ */
+static void
+alarm_slot_free(alarm_item_t alarm) {
+	int index;
+
+	index = alarm -> alarm_id & (ALARM_MAX_SLOTS - 1);
+	alarm -> alarm_id = -1;
+	alarm -> generation = (alarm -> generation + 1) & ALARM_GENERATION_MASK;
+	alarm -> next_free = alarm_free_slot;
+	alarm_free_slot = index;
+}
+
+/*
+ * Pull the deadline in to a newly filed expiry.
+ * Must be called with interrupts disabled.
+ */
+static void
+alarm_lower_deadline(long expires) {
+	if (alarm_deadline == -1 || expires < alarm_deadline) {
+		alarm_deadline = expires;
+	}
+}
+
+/*
+ * insert alarm event into the alarm wheel
  * returns an "alarm id", which is an integer that identifies the
  * alarm.
  */
 int
 register_alarm(int delay, proc_t func, arg_t arg) {
     alarm_item_t alarm;
+	interrupt_level_t level;
     if(NULL == func || delay < 0) {
         return -1;
     }
-    alarm = (alarm_item_t)malloc(sizeof(struct alarm_item));
+	level = set_interrupt_level(DISABLED);
+    alarm = alarm_slot_alloc();
     if(NULL == alarm) {
+		set_interrupt_level(level);
         return -1;
     }
+	// an empty wheel may have been left behind while idle, file relative to now
+	timing_wheel_resync(alarm_wheel, ticks);
     alarm -> alarm_func = func;
+	alarm -> alarm_func_arg = arg;
     //convert delay in millisec to ticks
     alarm -> delay = (long)((double)delay/(double)(PERIOD/MILLISECOND)) + ticks;
-    
-    //Failure case: alarm is missed if delay = ticks 
+
+    //Failure case: alarm is missed if delay = ticks
     if(alarm -> delay == ticks) {
-        alarm -> delay += 1; 
+        alarm -> delay += 1;
     }
-    alarm -> alarm_func_arg = arg;
-    alarm -> alarm_id = gen_alarm_id++;
-    queue_insert_sorted(alarm_queue, &compare_alarms, alarm);
+	alarm -> entry.expires = alarm -> delay;
+	alarm -> entry.data = alarm;
+	timing_wheel_insert(alarm_wheel, &alarm -> entry);
+	alarm_lower_deadline(alarm -> delay);
+	set_interrupt_level(level);
     return alarm -> alarm_id;
 }
 
+/*
+ * delete a given alarm
+ * it is ok to try to delete an alarm that has already executed.
+ * The caller to deregister_alarm must ensure that the alarm element func_arg is freed.
+ */
+void
+deregister_alarm(int alarmid) {
+	alarm_item_t alarm;
+	interrupt_level_t level;
+
+	if (alarmid < 0) {
+		return;
+	}
+	level = set_interrupt_level(DISABLED);
+	if ((alarmid & (ALARM_MAX_SLOTS - 1)) < alarm_slots) {
+		alarm = alarm_slot(alarmid & (ALARM_MAX_SLOTS - 1));
+		// a stale id no longer matches the slot's generation
+		if (alarm -> alarm_id == alarmid) {
+			timing_wheel_remove(alarm_wheel, &alarm -> entry);
+			alarm_slot_free(alarm);
+			// the cancelled alarm may have been the one the deadline waited for
+			alarm_deadline = timing_wheel_next_expiry(alarm_wheel);
+		}
+	}
+	set_interrupt_level(level);
+}
+
+long
+alarm_get_expiry(int alarmid) {
+	alarm_item_t alarm;
+	interrupt_level_t level;
+	long expiry;
+
+	if (alarmid < 0) {
+		return -1;
+	}
+	expiry = -1;
+	level = set_interrupt_level(DISABLED);
+	if ((alarmid & (ALARM_MAX_SLOTS - 1)) < alarm_slots) {
+		alarm = alarm_slot(alarmid & (ALARM_MAX_SLOTS - 1));
+		if (alarm -> alarm_id == alarmid) {
+			expiry = alarm -> delay;
+		}
+	}
+	set_interrupt_level(level);
+	return expiry;
+}
+
 int
-compare_alarms(void* item1, void* item2) {
-    if(((alarm_item_t)item1) -> delay < ((alarm_item_t)item2) -> delay) {
+init_alarm_wheel() {
+	alarm_slots = 0;
+	alarm_free_slot = -1;
+	alarm_deadline = -1;
+    alarm_wheel = timing_wheel_new(ticks);
+    if(NULL == alarm_wheel) {
         return -1;
-    } else if( ((alarm_item_t)item1) -> delay == ((alarm_item_t)item2) -> delay) {
-        return 0;
-    } else {
-        return 1;
     }
+    return 0;
 }
 
+/*
+ * Ticks before the deadline cannot expire anything, so the wheel is left
+ * where it is and advanced over all of them at once when the deadline
+ * arrives, jumping the empty stretches. Cancelling an alarm recomputes the
+ * deadline. With no alarm pending the empty wheel is moved straight to the
+ * current tick, so idle time is never turned through.
+ */
 int
-delete_by_id_predicate(void* arg1, void* arg2) {
-	if (((alarm_item_t)arg1)->alarm_id == (int)arg2) {
+alarm_advance() {
+	int expired;
+
+	if (alarm_deadline == -1) {
+		// nothing pending, keep the wheel at the current tick for free
+		timing_wheel_resync(alarm_wheel, ticks);
+		return 0;
+	}
+	if (ticks < alarm_deadline) {
 		return 0;
 	}
-	return -1;
+	expired = timing_wheel_advance(alarm_wheel, ticks);
+	alarm_deadline = timing_wheel_next_expiry(alarm_wheel);
+	return expired;
+}
+
+long
+alarm_next_deadline() {
+	return alarm_deadline;
 }
 
 /*
- * delete a given alarm  
- * it is ok to try to delete an alarm that has already executed.
- * The caller to deregister_alarm must ensure that the alarm element func_arg is freed.
+ * Drain every alarm that is due in one pass. The alarm is unlinked with
+ * interrupts disabled and its function runs with the caller's level restored.
  */
 void
-deregister_alarm(int alarmid) {
-	alarm_item_t alarm_item;
-	alarm_item = (alarm_item_t)queue_delete_by_predicate(alarm_queue, &delete_by_id_predicate, (void *)alarmid);
-    free(alarm_item);
-}
+alarm_fire_expired() {
+	timing_wheel_entry_t entry;
+	alarm_item_t alarm;
+	proc_t func;
+	arg_t arg;
+	interrupt_level_t level;
 
-queue_t
-init_alarm_queue() {
-    gen_alarm_id = 0;
-    alarm_queue = queue_new();
-    if(NULL == alarm_queue) {
-        return NULL;
-    }
-    return alarm_queue;
+	while (1) {
+		level = set_interrupt_level(DISABLED);
+		if (timing_wheel_expired_dequeue(alarm_wheel, &entry) == -1) {
+			set_interrupt_level(level);
+			return;
+		}
+		alarm = (alarm_item_t)entry -> data;
+		func = alarm -> alarm_func;
+		arg = alarm -> alarm_func_arg;
+		alarm_slot_free(alarm);
+		set_interrupt_level(level);
+		func(arg);
+	}
 }
 
 long
@@ -92,10 +259,19 @@ alarm_get_delay(alarm_item_t alarm) {
 
 int
 alarm_set_delay(alarm_item_t alarm, long delay) {
+	interrupt_level_t level;
     if(NULL == alarm) {
         return -1;
     }
+	level = set_interrupt_level(DISABLED);
     alarm -> delay = delay;
+	// re-file a pending alarm under its new expiry
+	if (timing_wheel_remove(alarm_wheel, &alarm -> entry) == 0) {
+		alarm -> entry.expires = delay;
+		timing_wheel_insert(alarm_wheel, &alarm -> entry);
+		alarm_lower_deadline(delay);
+	}
+	set_interrupt_level(level);
     return 0;
 }
 
@@ -108,4 +284,3 @@ arg_t
 alarm_get_func_arg(alarm_item_t alarm) {
     return alarm -> alarm_func_arg;
 }
-
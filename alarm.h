@@ -4,10 +4,14 @@
 /*
  * This is the alarm interface. You should implement the functions for these
  * prototypes, though you may have to modify some other files to do so.
+ *
+ * Pending alarms live on a hierarchical timing wheel (see timing_wheel.h), so
+ * registering, cancelling and the per-tick expiry check are all O(1). Alarm
+ * ids index directly into a slab of recycled alarm slots, so deregistering
+ * an id that has already fired or been cancelled is a harmless no-op.
  */
 
 /* register an alarm to go off in "delay" milliseconds, call func(arg) */
-#include "queue.h"
 #include "machineprimitives.h"
 
 typedef struct alarm_item *alarm_item_t;
@@ -16,9 +20,33 @@ int register_alarm(int delay, proc_t func, arg_t arg);
 
 void deregister_alarm(int alarmid);
 
-queue_t init_alarm_queue();
+/*
+ * Return the tick a pending alarm is due at, or -1 if the id has already
+ * fired or been cancelled.
+ */
+long alarm_get_expiry(int alarmid);
 
-int compare_alarms(void* item1, void* item2);
+/*
+ * Set up the alarm wheel. Return 0 (success) or -1 (failure).
+ */
+int init_alarm_wheel();
+
+/*
+ * Turn the alarm wheel up to the current tick. Called from the clock handler
+ * with interrupts disabled. Returns the number of alarms that fell due, so the
+ * caller can wake the alarm thread once for the whole batch.
+ */
+int alarm_advance();
+
+/*
+ * Return a tick no pending alarm fires before, or -1 if none is pending.
+ */
+long alarm_next_deadline();
+
+/*
+ * Run every alarm that has fallen due. Called by the alarm thread.
+ */
+void alarm_fire_expired();
 
 long alarm_get_delay(alarm_item_t alarm);
 int alarm_set_delay(alarm_item_t alarm, long delay);
@@ -3,32 +3,187 @@
 #include <string.h>
 #include "hashtable.h"
 
-typedef struct hashtable_node {
-    // Need to save because indexed by hash
-    void *key;
+/*
+ * Open addressing with linear probing over an array of inline slots.
+ *
+ * A removed entry leaves a tombstone so that probe chains running through it
+ * stay intact; probing stops at the first slot that has never been used. The
+ * capacity is a power of two. Once live entries and tombstones fill
+ * HASHTABLE_LOAD_NUM/HASHTABLE_LOAD_DEN of the slots, a new array is
+ * allocated (twice as large unless most of the fill was tombstones) and the
+ * old one is drained into it a few slots per put, so no single put pays for
+ * rehashing the whole table. Until it is drained, lookups check both arrays.
+ */
+#define HASHTABLE_MIN_CAPACITY 8
+#define HASHTABLE_LOAD_NUM 3
+#define HASHTABLE_LOAD_DEN 4
+#define HASHTABLE_MIGRATE_STEP 4
+
+// key of a slot whose entry was removed
+static char tombstone;
+#define TOMBSTONE ((void *) &tombstone)
+
+typedef struct hashtable_slot {
+    void *key; // NULL if never used, TOMBSTONE if removed
     void *value;
-} *hashtable_node_t;
+    unsigned short hash;
+} *hashtable_slot_t;
+
+typedef struct hashtable_array {
+    hashtable_slot_t slots;
+    unsigned int capacity;
+    unsigned int bits; // capacity == 1 << bits
+    unsigned int used; // live entries and tombstones
+} *hashtable_array_t;
 
 struct hashtable {
-    //maximum size of hash table
-    unsigned int max_size;
-    //filled hash table size
+    //live entries in both arrays
     unsigned int size;
     hashFunc hash;
     equalsFunc equals;
-    //hash node - <key,value> pair
-    hashtable_node_t *table;
+    struct hashtable_array table;
+    //array being drained into table, capacity 0 if none
+    struct hashtable_array old;
+    //next slot of old to migrate
+    unsigned int migrate_index;
 };
 
+static int
+array_init(hashtable_array_t array, unsigned int capacity) {
+    array->bits = 0;
+    while ((1U << array->bits) < capacity) {
+        array->bits++;
+    }
+    array->capacity = 1U << array->bits;
+    array->used = 0;
+    array->slots = (hashtable_slot_t) malloc(array->capacity * sizeof(struct hashtable_slot));
+    if (array->slots == NULL) {
+        fprintf(stderr, "Could not allocate hash table memory\n");
+        array->capacity = 0;
+        return -1;
+    }
+    memset(array->slots, 0, array->capacity * sizeof(struct hashtable_slot));
+    return 0;
+}
+
+/*
+ * Home slot of a hash. Fibonacci hashing spreads the 16 bit hashes over the
+ * whole array even when only their low bits differ.
+ */
+static unsigned int
+home_slot(hashtable_array_t array, unsigned short hash) {
+    return (unsigned int)((hash * 2654435761UL) & 0xffffffffUL) >> (32 - array->bits);
+}
+
+/*
+ * Return the slot holding key in array, or NULL if it is not there.
+ */
+static hashtable_slot_t
+array_find(hashtable_t hashtable, hashtable_array_t array, void *key, unsigned short hash) {
+    unsigned int index, probes;
+    hashtable_slot_t slot;
+
+    if (array->capacity == 0) {
+        return NULL;
+    }
+    index = home_slot(array, hash);
+    for (probes = 0; probes < array->capacity; probes++) {
+        slot = &array->slots[index];
+        if (slot->key == NULL) {
+            return NULL;
+        }
+        if (slot->key != TOMBSTONE && slot->hash == hash && hashtable->equals(key, slot->key)) {
+            return slot;
+        }
+        index = (index + 1) & (array->capacity - 1);
+    }
+    return NULL;
+}
+
+/*
+ * Store an entry known not to be in array, reusing the first tombstone on
+ * its probe chain. The caller guarantees a free slot.
+ */
+static void
+array_insert(hashtable_array_t array, void *key, void *value, unsigned short hash) {
+    unsigned int index;
+    hashtable_slot_t slot;
+
+    index = home_slot(array, hash);
+    while (array->slots[index].key != NULL && array->slots[index].key != TOMBSTONE) {
+        index = (index + 1) & (array->capacity - 1);
+    }
+    slot = &array->slots[index];
+    if (slot->key == NULL) {
+        array->used++;
+    }
+    slot->key = key;
+    slot->value = value;
+    slot->hash = hash;
+}
+
+/*
+ * Move up to HASHTABLE_MIGRATE_STEP live entries from the old array to the
+ * new one, freeing the old array once it is empty.
+ */
+static void
+migrate(hashtable_t hashtable) {
+    int moved;
+    hashtable_slot_t slot;
+
+    moved = 0;
+    while (hashtable->old.capacity > 0 && moved < HASHTABLE_MIGRATE_STEP) {
+        if (hashtable->migrate_index == hashtable->old.capacity) {
+            free(hashtable->old.slots);
+            hashtable->old.slots = NULL;
+            hashtable->old.capacity = 0;
+            return;
+        }
+        slot = &hashtable->old.slots[hashtable->migrate_index++];
+        if (slot->key != NULL && slot->key != TOMBSTONE) {
+            array_insert(&hashtable->table, slot->key, slot->value, slot->hash);
+            slot->key = TOMBSTONE;
+            moved++;
+        }
+    }
+}
+
+/*
+ * Start draining the current array into a fresh one. Finishes any migration
+ * still in progress first, so there are never more than two arrays.
+ */
+static int
+grow(hashtable_t hashtable) {
+    struct hashtable_array fresh;
+    unsigned int capacity;
+
+    while (hashtable->old.capacity > 0) {
+        migrate(hashtable);
+    }
+    capacity = hashtable->table.capacity;
+    // only double if live entries, not tombstones, are what filled it
+    if (hashtable->size * 2 >= capacity) {
+        capacity *= 2;
+    }
+    if (array_init(&fresh, capacity) == -1) {
+        return -1;
+    }
+    hashtable->old = hashtable->table;
+    hashtable->table = fresh;
+    hashtable->migrate_index = 0;
+    return 0;
+}
+
 hashtable_t
 hashtable_init(unsigned int size, hashFunc func, equalsFunc equals) {
     hashtable_t hashtable;
-    
+    unsigned int capacity;
+
     //validate parameters
     if (size < 1 || func == NULL || equals == NULL) {
         return NULL;
     }
-    
+
     hashtable = (hashtable_t) malloc(sizeof(struct hashtable));
     if (hashtable == NULL) {
         fprintf(stderr, "Out of memory\n");
@@ -36,133 +191,209 @@ hashtable_init(unsigned int size, hashFunc func, equalsFunc equals) {
     }
     hashtable->hash = func;
     hashtable->equals = equals;
-    hashtable->max_size = size;
     hashtable->size = 0;
-    hashtable->table = (hashtable_node_t *) malloc(size * sizeof(hashtable_node_t));
-    if (hashtable->table == NULL) {
-        fprintf(stderr, "Could not allocate hash table memory\n");
+    // size is the number of entries expected, leave room under the load limit
+    capacity = size * HASHTABLE_LOAD_DEN / HASHTABLE_LOAD_NUM + 1;
+    if (capacity < HASHTABLE_MIN_CAPACITY) {
+        capacity = HASHTABLE_MIN_CAPACITY;
+    }
+    if (array_init(&hashtable->table, capacity) == -1) {
         free(hashtable);
+        return NULL;
     }
-    
-    memset(hashtable->table, 0, size * sizeof(hashtable_node_t));
+    hashtable->old.slots = NULL;
+    hashtable->old.capacity = 0;
+    hashtable->old.used = 0;
+    hashtable->migrate_index = 0;
     return hashtable;
 }
 
 int
 hashtable_get(hashtable_t hashtable, void *key, void **value) {
-    unsigned int hash_table_index = 0;
-    int hash_key_index, hash;
+    unsigned short hash;
+    hashtable_slot_t slot;
+
     if(hashtable == NULL || key == NULL) {
+        if (value != NULL) {
+            *value = NULL;
+        }
         return -1;
     }
     hash = hashtable->hash(key);
-    
-    hash_key_index = (hash) % hashtable -> max_size;
-    hash_key_index = ( hash_key_index < 0 ) ? hash_key_index + hashtable->max_size : hash_key_index;
-    
-    // search table
-    while ((hash_table_index < hashtable->max_size) && ((hashtable->table[hash_key_index] == NULL) ||
-            ((hashtable->table[hash_key_index] != NULL) && !(hashtable->equals(key ,hashtable->table[hash_key_index]->key))))) {
-        hash_table_index++;
-        hash_key_index = (hash_key_index == hashtable->max_size - 1) ? 0 : hash_key_index + 1;
-    }
-    
-    //reached end of hash table
-    if (hash_table_index == hashtable->max_size) {
+    slot = array_find(hashtable, &hashtable->table, key, hash);
+    if (slot == NULL) {
+        slot = array_find(hashtable, &hashtable->old, key, hash);
+    }
+    if (slot == NULL) {
         *value = NULL;
         return -1;
     }
-    
-    *value = hashtable->table[hash_key_index]->value;
+    *value = slot->value;
     return 0;
 }
 
 void*
 hashtable_remove(hashtable_t hashtable, void *key) {
-    unsigned int hash_table_index = 0;
-    int hash_key_index;
+    unsigned short hash;
+    hashtable_slot_t slot;
     void *ret;
-    
-    int hash = hashtable->hash(key);
-    
-    hash_key_index = (hash) % hashtable->max_size;
-    // validate hash_key_index
-    hash_key_index = ( hash_key_index < 0 ) ? hash_key_index + hashtable->max_size : hash_key_index;
-    
-    // search table
-    while ((hash_table_index < hashtable->max_size) && ((hashtable->table[hash_key_index] == NULL) || ((hashtable->table[hash_key_index] != NULL) && !(hashtable->equals(key ,hashtable->table[hash_key_index]->key))))) {
-        hash_table_index++;
-        hash_key_index = (hash_key_index == hashtable->max_size - 1) ? 0 : hash_key_index + 1;
-    }
-    
+
+    if (hashtable == NULL || key == NULL) {
+        return NULL;
+    }
+    hash = hashtable->hash(key);
+    slot = array_find(hashtable, &hashtable->table, key, hash);
+    if (slot == NULL) {
+        slot = array_find(hashtable, &hashtable->old, key, hash);
+    }
     // not in table
-    if (hash_table_index == hashtable->max_size) {
+    if (slot == NULL) {
         return NULL;
     }
-    
-    ret = hashtable->table[hash_key_index]->key;
-    free(hashtable->table[hash_key_index]);
-    hashtable->table[hash_key_index] = NULL;
+    ret = slot->key;
+    slot->key = TOMBSTONE;
+    slot->value = NULL;
     (hashtable->size)--;
-    
+
     return ret;
 }
 
 int
 hashtable_put(hashtable_t hashtable, void *key, void *value) {
-    unsigned int hash_table_index = 0;
-    int hash_key_index, hash;
-    hashtable_node_t temp;
-    
+    unsigned short hash;
+    hashtable_slot_t slot;
+
     if(hashtable == NULL || key== NULL || value== NULL) {
         return -1;
     }
     hash = hashtable->hash(key);
-    
-    hash_key_index = (hash) % hashtable->max_size;
-    // validate hash key index
-    hash_key_index = ( hash_key_index < 0 ) ? hash_key_index + hashtable->max_size : hash_key_index;
-    
-    // search table
-    while ((hash_table_index < hashtable->max_size) && (hashtable->table[hash_key_index] != NULL)) {
-        hash_table_index++;
-        hash_key_index = (hash_key_index == hashtable->max_size - 1) ? 0 : hash_key_index + 1;
-    }
-    
-    //hash table full
-    if (hash_table_index == hashtable->max_size) {
-        return -1;
+
+    // an existing entry for the key gets the new value and keeps its key
+    slot = array_find(hashtable, &hashtable->table, key, hash);
+    if (slot != NULL) {
+        slot->value = value;
+        migrate(hashtable);
+        return 0;
     }
-    
-    temp = (hashtable_node_t) malloc(sizeof(struct hashtable_node));
-    if (temp == NULL) return -1;
-    
-    temp->key = key;
-    temp->value = value;
-    hashtable->table[hash_key_index] = temp;
+    slot = array_find(hashtable, &hashtable->old, key, hash);
+    if (slot != NULL) {
+        slot->value = value;
+        migrate(hashtable);
+        return 0;
+    }
+
+    if ((hashtable->table.used + 1) * HASHTABLE_LOAD_DEN > hashtable->table.capacity * HASHTABLE_LOAD_NUM) {
+        if (grow(hashtable) == -1) {
+            return -1;
+        }
+    }
+    array_insert(&hashtable->table, key, value, hash);
     (hashtable->size)++;
-    
+    migrate(hashtable);
+
     return 0;
 }
 
 int
 hashtable_size(hashtable_t hashtable) {
+    if (hashtable == NULL) {
+        return -1;
+    }
     return hashtable->size;
 }
 
+/*
+ * Apply func to the live entries of one array. Removing an entry only
+ * tombstones its slot, so the walk is not disturbed.
+ */
+static int
+array_iterate(hashtable_array_t array, hashtable_func func, void *arg) {
+    unsigned int i;
+    hashtable_slot_t slot;
+
+    for (i = 0; i < array->capacity; i++) {
+        slot = &array->slots[i];
+        if (slot->key != NULL && slot->key != TOMBSTONE) {
+            if (func(arg, slot->key, slot->value) == -1) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int
+hashtable_iterate(hashtable_t hashtable, hashtable_func func, void *arg) {
+    if (hashtable == NULL || func == NULL) {
+        return -1;
+    }
+    // only a put migrates entries, so each is in exactly one array throughout
+    if (array_iterate(&hashtable->old, func, arg) == -1) {
+        return -1;
+    }
+    return array_iterate(&hashtable->table, func, arg);
+}
+
+void
+hashtable_clear(hashtable_t hashtable) {
+    if (hashtable == NULL) {
+        return;
+    }
+    free(hashtable->old.slots);
+    hashtable->old.slots = NULL;
+    hashtable->old.capacity = 0;
+    hashtable->migrate_index = 0;
+    memset(hashtable->table.slots, 0, hashtable->table.capacity * sizeof(struct hashtable_slot));
+    hashtable->table.used = 0;
+    hashtable->size = 0;
+}
+
+static void
+array_stats(hashtable_array_t array, hashtable_stats_t *stats, unsigned long *total_probe) {
+    unsigned int i, probe;
+    hashtable_slot_t slot;
+
+    for (i = 0; i < array->capacity; i++) {
+        slot = &array->slots[i];
+        if (slot->key == NULL || slot->key == TOMBSTONE) {
+            continue;
+        }
+        probe = ((i - home_slot(array, slot->hash)) & (array->capacity - 1)) + 1;
+        *total_probe += probe;
+        if (probe > stats->max_probe) {
+            stats->max_probe = probe;
+        }
+        if (probe > 1) {
+            stats->collisions++;
+        }
+    }
+}
+
+int
+hashtable_get_stats(hashtable_t hashtable, hashtable_stats_t *stats) {
+    unsigned long total_probe;
+
+    if (hashtable == NULL || stats == NULL) {
+        return -1;
+    }
+    total_probe = 0;
+    stats->size = hashtable->size;
+    stats->capacity = hashtable->table.capacity;
+    stats->load_factor = (double) hashtable->size / hashtable->table.capacity;
+    stats->max_probe = 0;
+    stats->collisions = 0;
+    array_stats(&hashtable->old, stats, &total_probe);
+    array_stats(&hashtable->table, stats, &total_probe);
+    stats->avg_probe = hashtable->size > 0 ? (double) total_probe / hashtable->size : 0;
+    return 0;
+}
+
 void
-hashtable_free(hashtable_t hashtable) {
-    unsigned int hash_table_index = 0;
-    int hash_key_index = 0;
-    hashtable_node_t temp;
-    
-    while (hash_table_index < hashtable->max_size) {
-        temp = hashtable->table[hash_key_index];
-        if (temp != NULL) free(temp);
-        hash_table_index++;
-        hash_key_index++;
-    }
-    
-    free(hashtable->table);
+hashtable_destroy(hashtable_t hashtable) {
+    if (hashtable == NULL) {
+        return;
+    }
+    free(hashtable->old.slots);
+    free(hashtable->table.slots);
     free(hashtable);
-}
\ No newline at end of file
+}
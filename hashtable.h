@@ -1,5 +1,6 @@
 /*
- * Hashtable implementation with linear probing for collision prevention
+ * Hashtable implementation with open addressing and linear probing. The table
+ * grows as entries are added, so a put only fails if memory runs out.
  */
 
 #ifndef __HASHTABLE_H__
@@ -18,7 +19,8 @@ typedef unsigned short (*hashFunc)(void*);
 typedef unsigned short (*equalsFunc)(void*, void*);
 
 /*
- * Initialize the table with a size and hashFunc hash and equalsFunc equals.
+ * Initialize the table with a size, the number of entries it should hold
+ * before it first has to grow, and hashFunc hash and equalsFunc equals.
  * Returns NULL on failure.
  */
 hashtable_t hashtable_init(unsigned int size, hashFunc hash, equalsFunc equals);
@@ -36,7 +38,8 @@ int hashtable_get(hashtable_t tbl, void *key, void **value);
 void *hashtable_remove(hashtable_t hashtable, void *key);
 
 /*
- * Put a key, value pair onto the table.
+ * Put a key, value pair onto the table. If key is already present, its value
+ * is replaced and the key stored with it is kept.
  * Return 0(success) or -1(failure)
  */
 int hashtable_put(hashtable_t hashtable, void *key, void *value);
@@ -46,6 +49,45 @@ int hashtable_put(hashtable_t hashtable, void *key, void *value);
  */
 int hashtable_size(hashtable_t hashtable);
 
+/*
+ * Function applied to entries by hashtable_iterate. It is passed the arg
+ * given to hashtable_iterate first, then the entry's key and value. Return
+ * -1 to stop the iteration early.
+ */
+typedef int (*hashtable_func)(void *arg, void *key, void *value);
+
+/*
+ * Apply func to every entry, in no particular order. func may remove the
+ * entry it is given, but must not put. Return 0 (success) or -1 if func
+ * stopped the iteration or the arguments are invalid.
+ */
+int hashtable_iterate(hashtable_t hashtable, hashtable_func func, void *arg);
+
+/*
+ * Remove every entry, keeping the table's capacity. As with
+ * hashtable_destroy, keys and values are left to the caller.
+ */
+void hashtable_clear(hashtable_t hashtable);
+
+/*
+ * Probe statistics. The probe length of an entry is the number of slots a
+ * lookup of it examines; a collision is an entry not in its home slot.
+ */
+typedef struct hashtable_stats {
+    unsigned int size;
+    unsigned int capacity;
+    double load_factor;
+    unsigned int max_probe;
+    double avg_probe;
+    unsigned int collisions;
+} hashtable_stats_t;
+
+/*
+ * Fill in stats for the table's current contents. Walks the whole table.
+ * Return 0(success) or -1(failure)
+ */
+int hashtable_get_stats(hashtable_t hashtable, hashtable_stats_t *stats);
+
 /*
  * Destroy the hash table. It is left to the application programmer to free the value 
  * stored under the keys.
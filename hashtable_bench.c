@@ -0,0 +1,74 @@
+/*
+ * Hash table lookup benchmark.
+ *
+ * Fills a table to increasing load factors, stopping short of the point
+ * where it would grow, and times lookups that hit and lookups that miss at
+ * each one. Plain C, no minithreads needed.
+ *
+ * Change CAPACITY and LOOKUPS to vary the size of the table and of each run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hashtable.h"
+
+#define CAPACITY 4096
+#define LOOKUPS 4000000
+
+int keys[2 * CAPACITY];
+
+unsigned short
+int_hash(void *a) {
+    return (unsigned short) *((int *) a);
+}
+
+unsigned short
+int_equals(void *a, void *b) {
+    return *((int *) a) == *((int *) b);
+}
+
+static double
+lookups_per_second(hashtable_t table, int first, int count) {
+    clock_t start, end;
+    void *value;
+    int i;
+
+    start = clock();
+    for (i = 0; i < LOOKUPS; i++) {
+        hashtable_get(table, &keys[first + i % count], &value);
+    }
+    end = clock();
+    if (end == start) {
+        end = start + 1;
+    }
+    return LOOKUPS / ((double)(end - start) / CLOCKS_PER_SEC);
+}
+
+int
+main() {
+    hashtable_t table;
+    hashtable_stats_t stats;
+    int percent, entries, i;
+
+    for (i = 0; i < 2 * CAPACITY; i++) {
+        // spread keys out so they do not land in consecutive slots
+        keys[i] = i * 7919;
+    }
+    printf("load   hits/s        misses/s      avg probe  max probe\n");
+    for (percent = 10; percent <= 70; percent += 10) {
+        entries = CAPACITY * percent / 100;
+        // sized so that entries fit in CAPACITY slots without growing
+        table = hashtable_init(CAPACITY * 3 / 4 - 1, int_hash, int_equals);
+        for (i = 0; i < entries; i++) {
+            hashtable_put(table, &keys[i], &keys[i]);
+        }
+        hashtable_get_stats(table, &stats);
+        printf("%3d%%   %-12.0f  %-12.0f  %-9.2f  %u\n", percent,
+               lookups_per_second(table, 0, entries),
+               lookups_per_second(table, CAPACITY, entries),
+               stats.avg_probe, stats.max_probe);
+        hashtable_destroy(table);
+    }
+    return 0;
+}
@@ -19,13 +19,60 @@ test_saturation() {
     hashtable_t table = hashtable_init(2, hash, equals);
     int a,b,c;
     int _1,_2,_3;
+    int *temp;
     a = _1 = 1;
     b = _2 = 2;
     c = _3 = 3;
     assert(hashtable_put(table, &a, &_1) == 0);
     assert(hashtable_put(table, &b, &_2) == 0);
-    assert(hashtable_put(table, &c, &_3) == -1);
-    hashtable_free(table);
+    // the table grows past the size it was created with
+    assert(hashtable_put(table, &c, &_3) == 0);
+    assert(hashtable_size(table) == 3);
+    assert(hashtable_get(table, &c, &temp) == 0);
+    assert(*temp == _3);
+    hashtable_destroy(table);
+}
+
+void
+test_growth() {
+    hashtable_t table = hashtable_init(1, hash, equals);
+    int keys[1000];
+    int *temp;
+    int i;
+    for (i = 0; i < 1000; i++) {
+        keys[i] = i * 64;
+        assert(hashtable_put(table, &keys[i], &keys[i]) == 0);
+        // every entry stays reachable while the table is being migrated
+        assert(hashtable_get(table, &keys[i / 2], &temp) == 0);
+        assert(temp == &keys[i / 2]);
+    }
+    for (i = 0; i < 1000; i += 2) {
+        assert(hashtable_remove(table, &keys[i]) == &keys[i]);
+    }
+    assert(hashtable_size(table) == 500);
+    for (i = 0; i < 1000; i++) {
+        assert(hashtable_get(table, &keys[i], &temp) == (i % 2 ? 0 : -1));
+    }
+    hashtable_destroy(table);
+}
+
+void
+test_replace() {
+    hashtable_t table = hashtable_init(3, hash, equals);
+    int a, b;
+    int _1,_2;
+    int *temp;
+    a = b = 5;
+    _1 = 1;
+    _2 = 2;
+    assert(hashtable_put(table, &a, &_1) == 0);
+    assert(hashtable_put(table, &b, &_2) == 0);
+    assert(hashtable_size(table) == 1);
+    assert(hashtable_get(table, &a, &temp) == 0);
+    assert(*temp == _2);
+    // the key first stored is kept
+    assert(hashtable_remove(table, &b) == &a);
+    hashtable_destroy(table);
 }
 
 void
@@ -53,7 +100,7 @@ test_get() {
     
     assert(hashtable_get(table, &d, &temp) == -1);
     assert(temp == NULL);
-    hashtable_free(table);
+    hashtable_destroy(table);
 }
 
 void
@@ -83,7 +130,7 @@ test_collision() {
     
     assert(hashtable_get(table, &d, &temp) == -1);
     assert(temp == NULL);
-    hashtable_free(table);
+    hashtable_destroy(table);
 }
 
 void
@@ -118,7 +165,78 @@ test_remove() {
     assert(hashtable_get(table, &a, &temp) == -1);
     assert(temp == NULL);
     
-    hashtable_free(table);
+    // entries probed past the removed one are still found
+    assert(hashtable_get(table, &b, &temp) == 0);
+    assert(*temp == _2);
+    assert(hashtable_get(table, &c, &temp) == 0);
+    assert(*temp == _3);
+    
+    hashtable_destroy(table);
+}
+
+int
+remove_even(hashtable_t table, int *key, int *value) {
+    (*value)++;
+    if (*key % 2 == 0) {
+        hashtable_remove(table, key);
+    }
+    return 0;
+}
+
+int
+stop_at_three(int *seen, int *key, int *value) {
+    return ++(*seen) == 3 ? -1 : 0;
+}
+
+void
+test_iterate() {
+    hashtable_t table = hashtable_init(4, hash, equals);
+    int keys[20], counts[20];
+    int *temp;
+    int i, seen;
+    for (i = 0; i < 20; i++) {
+        keys[i] = i;
+        counts[i] = 0;
+        assert(hashtable_put(table, &keys[i], &counts[i]) == 0);
+    }
+    // entries can be removed as they are visited
+    assert(hashtable_iterate(table, (hashtable_func) remove_even, table) == 0);
+    for (i = 0; i < 20; i++) {
+        assert(counts[i] == 1);
+        assert(hashtable_get(table, &keys[i], &temp) == (i % 2 ? 0 : -1));
+    }
+    assert(hashtable_size(table) == 10);
+    seen = 0;
+    assert(hashtable_iterate(table, (hashtable_func) stop_at_three, &seen) == -1);
+    assert(seen == 3);
+    hashtable_clear(table);
+    assert(hashtable_size(table) == 0);
+    assert(hashtable_get(table, &keys[1], &temp) == -1);
+    assert(hashtable_put(table, &keys[1], &counts[1]) == 0);
+    assert(hashtable_get(table, &keys[1], &temp) == 0);
+    hashtable_destroy(table);
+}
+
+void
+test_stats() {
+    hashtable_t table = hashtable_init(8, hash, equals);
+    hashtable_stats_t stats;
+    int keys[6];
+    int i;
+    assert(hashtable_get_stats(table, &stats) == 0);
+    assert(stats.size == 0 && stats.max_probe == 0 && stats.collisions == 0);
+    // equal hashes all share one home slot
+    for (i = 0; i < 6; i++) {
+        keys[i] = i * 65536;
+        assert(hashtable_put(table, &keys[i], &keys[i]) == 0);
+    }
+    assert(hashtable_get_stats(table, &stats) == 0);
+    assert(stats.size == 6);
+    assert(stats.max_probe == 6);
+    assert(stats.collisions == 5);
+    assert(stats.avg_probe == 3.5);
+    assert(stats.load_factor == 6.0 / stats.capacity);
+    hashtable_destroy(table);
 }
 
 int
@@ -134,6 +252,21 @@ main() {
     printf("Testing hash collisions...\n");
     test_collision();
     
+    printf("Testing hash table removal...\n");
+    test_remove();
+    
+    printf("Testing hash table replacement...\n");
+    test_replace();
+    
+    printf("Testing hash table growth...\n");
+    test_growth();
+    
+    printf("Testing hash table iteration...\n");
+    test_iterate();
+    
+    printf("Testing hash table statistics...\n");
+    test_stats();
+    
     printf("Testing done!\n");
     return 0;
 }
\ No newline at end of file
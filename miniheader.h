@@ -12,7 +12,14 @@
 enum { PROTOCOL_MINIDATAGRAM = 1, PROTOCOL_MINISTREAM };
 
 /* message types for minisockets */
-enum { MSG_SYN = 1, MSG_SYNACK, MSG_ACK, MSG_FIN };
+enum { MSG_SYN = 1, MSG_SYNACK, MSG_ACK, MSG_FIN, MSG_SACK };
+
+/*
+ * A MSG_SACK carries a cumulative ack_number like MSG_ACK, followed by a
+ * MINISTREAM_SACK_SIZE payload: a packed unsigned int whose bit i is set if
+ * segment ack_number + 2 + i has been received out of order.
+ */
+#define MINISTREAM_SACK_SIZE 4
 
 /* header definition for unreliable packets */
 typedef struct mini_header
@@ -207,7 +207,8 @@ void miniport_destroy(miniport_t miniport)
 int minimsg_send(miniport_t local_unbound_port, miniport_t local_bound_port, minimsg_t msg, int len)
 {
 	int sent;
-	mini_header_t header;
+	struct mini_header datagram;
+	mini_header_t header = &datagram;
 	network_address_t source_address;
 	// validate arguments, fail if the packet is too big
 	if (local_unbound_port == NULL ||
@@ -218,11 +219,6 @@ int minimsg_send(miniport_t local_unbound_port, miniport_t local_bound_port, min
 
 		return -1;
 	}
-	// form a miniheader
-	header = (mini_header_t) malloc(HEADER_SIZE);
-	if (header == NULL) {
-		return -1;
-	}
 	// pack the header
 	header->protocol = PROTOCOL_MINIDATAGRAM;
 	pack_unsigned_short(header->source_port, local_unbound_port->port_number);
@@ -233,10 +229,45 @@ int minimsg_send(miniport_t local_unbound_port, miniport_t local_bound_port, min
 	// send
 	sent = miniroute_send_pkt(local_bound_port->bound.remote_address, HEADER_SIZE, (char *) header, len, msg) - HEADER_SIZE;
 	printf("miniroute_send_pkt %d\n", sent);
-	free(header);
 	return sent;
 }
 
+/*
+ * Dequeue a datagram from the unbound port, creating a bound port that replies to
+ * its sender. If block is set, wait for one to arrive; otherwise give up at once
+ * when none is queued. Returns the packet, or NULL on failure.
+ */
+static network_interrupt_arg_t*
+next_datagram(miniport_t local_unbound_port, miniport_t* new_local_bound_port, int block) {
+	interrupt_level_t level;
+    network_interrupt_arg_t *payload;
+	mini_header_t header;
+	network_address_t sender;
+
+	if (local_unbound_port == NULL || local_unbound_port->type != UNBOUND) {
+		return NULL;
+	}
+    level = set_interrupt_level(DISABLED);
+	if (block) {
+		semaphore_P(local_unbound_port->unbound.datagrams_ready);
+	} else if (semaphore_tryP(local_unbound_port->unbound.datagrams_ready) == -1) {
+		set_interrupt_level(level);
+		return NULL;
+	}
+    if(queue_dequeue(local_unbound_port->unbound.incoming_data, (void **)&payload) == -1) {
+        fprintf(stdout, "error in minimsg_receive\n");
+        set_interrupt_level(level);
+        return NULL;
+    }
+    set_interrupt_level(level);
+
+	// reply to the original sender, not to the last hop that forwarded the packet
+	header = (mini_header_t) (payload->buffer + sizeof(struct routing_header));
+	unpack_address(header->source_address, sender);
+    *new_local_bound_port = miniport_create_bound(sender, unpack_unsigned_short(header->source_port));
+	return payload;
+}
+
 /* Receives a message through a locally unbound port. Threads that call this function are
  * blocked until a message arrives. Upon arrival of each message, the function must create
  * a new bound port that targets the sender's address and listening port, so that use of
@@ -247,25 +278,56 @@ int minimsg_send(miniport_t local_unbound_port, miniport_t local_bound_port, min
  */
 int minimsg_receive(miniport_t local_unbound_port, miniport_t* new_local_bound_port, minimsg_t msg, int *len)
 {
-	interrupt_level_t level;
     network_interrupt_arg_t *payload;
-	int receiver_port;
 
-	if (local_unbound_port == NULL) {
+	payload = next_datagram(local_unbound_port, new_local_bound_port, 1);
+	if (payload == NULL) {
 		return -1;
 	}
-    level = set_interrupt_level(DISABLED);
-	semaphore_P(local_unbound_port->unbound.datagrams_ready);
-    if(queue_dequeue(local_unbound_port->unbound.incoming_data, (void **)&payload)== 2) {
-        fprintf(stdout, "error in minimsg_receive\n");
-    }
-    set_interrupt_level(level);
     *len = payload->size - HEADER_SIZE - sizeof(struct routing_header);
 	memcpy(msg, payload->buffer + HEADER_SIZE + sizeof(struct routing_header), *len);
 
-	receiver_port = unpack_unsigned_short(&payload->buffer[9]);
-    *new_local_bound_port = miniport_create_bound(payload->addr, receiver_port);
-
 	free(payload);
 	return *len;
 }
+
+int minimsg_receive_batch(miniport_t local_unbound_port, minimsg_t msgs[], int lens[], int max, miniport_t new_local_bound_ports[])
+{
+    network_interrupt_arg_t *payload;
+	int received;
+
+	if (msgs == NULL || lens == NULL || new_local_bound_ports == NULL || max < 1) {
+		return -1;
+	}
+	// only the first datagram is waited for, the rest must already be queued
+	for (received = 0; received < max; received++) {
+		payload = next_datagram(local_unbound_port, &new_local_bound_ports[received], received == 0);
+		if (payload == NULL) {
+			break;
+		}
+		lens[received] = payload->size - HEADER_SIZE - sizeof(struct routing_header);
+		memcpy(msgs[received], payload->buffer + HEADER_SIZE + sizeof(struct routing_header), lens[received]);
+		free(payload);
+	}
+	return received > 0 ? received : -1;
+}
+
+int minimsg_receive_loan(miniport_t local_unbound_port, miniport_t* new_local_bound_port, const char** msg, int *len, minimsg_loan_t* loan)
+{
+    network_interrupt_arg_t *payload;
+
+	payload = next_datagram(local_unbound_port, new_local_bound_port, 1);
+	if (payload == NULL) {
+		*loan = NULL;
+		return -1;
+	}
+    *len = payload->size - HEADER_SIZE - sizeof(struct routing_header);
+	*msg = payload->buffer + HEADER_SIZE + sizeof(struct routing_header);
+	*loan = payload;
+	return *len;
+}
+
+void minimsg_return_loan(minimsg_loan_t loan)
+{
+	free(loan);
+}
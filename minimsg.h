@@ -76,6 +76,34 @@ extern int minimsg_send(miniport_t local_unbound_port, miniport_t local_bound_po
  */
 extern int minimsg_receive(miniport_t local_unbound_port, miniport_t* new_local_bound_port, minimsg_t msg, int *len);
 
+/* Receives up to max messages through a locally unbound port in one call. The calling
+ * thread blocks only if no message is queued; once one is available, it and any others
+ * already queued behind it are returned without further waiting. For each message i,
+ * msgs[i] (which must have room for MINIMSG_MAX_MSG_SIZE bytes) receives the payload,
+ * lens[i] its length and new_local_bound_ports[i] a bound port replying to its sender,
+ * as in minimsg_receive. The return value is the number of messages received, or -1 on
+ * failure.
+ */
+extern int minimsg_receive_batch(miniport_t local_unbound_port, minimsg_t msgs[], int lens[], int max, miniport_t new_local_bound_ports[]);
+
+/*
+ * A datagram on loan from minimsg_receive_loan. Its payload stays in the packet
+ * buffer it arrived in until the loan is returned with minimsg_return_loan.
+ */
+typedef network_interrupt_arg_t* minimsg_loan_t;
+
+/* Receives a message like minimsg_receive, but without copying the payload. msg is
+ * set to a read-only view of the payload inside the packet buffer and loan to the
+ * buffer itself, which the caller must pass to minimsg_return_loan once it is done
+ * with msg. The return value is the number of data payload bytes received.
+ */
+extern int minimsg_receive_loan(miniport_t local_unbound_port, miniport_t* new_local_bound_port, const char** msg, int *len, minimsg_loan_t* loan);
+
+/* Returns a packet buffer lent out by minimsg_receive_loan. The payload view it was
+ * lent with must not be used afterwards.
+ */
+extern void minimsg_return_loan(minimsg_loan_t loan);
+
 extern int miniport_unbound_enqueue(miniport_t port, network_interrupt_arg_t *data);
 
 #endif /*__MINIMSG_H__*/
@@ -6,7 +6,7 @@
 #include "synch.h"
 #include "alarm.h"
 #include "miniroute.h"
-#include "hashtable.h"
+#include "typed_hashtable.h"
 
 typedef struct route_cache_entry
 {
@@ -14,7 +14,8 @@ typedef struct route_cache_entry
     int path_len;
     network_address_t path[MAX_ROUTE_LENGTH];
     
-    semaphore_t routing_sem;
+    // broadcast once routing has succeeded or failed
+    condvar_t routing_done;
     //no. of threads waiting for a route to be found
     int waiting_count;
     
@@ -29,23 +30,19 @@ typedef struct route_cache_entry
     int routing_id;
 } *route_cache_entry_t;
 
-network_address_t local_address;
-hashtable_t routing_cache;
+// route cache keyed by destination address
+DEFINE_HASHTABLE(route_cache, network_address_t, route_cache_entry_t)
 
-unsigned short
-network_address_comparator(network_address_t a, network_address_t *b) {
-    return network_address_same(a, *b);
-}
-
-unsigned short
-hash_wrapper(network_address_t *addr) {
-    return hash_address(*addr);
-}
+network_address_t local_address;
+route_cache_t routing_cache;
 
 /* Performs any initialization of the miniroute layer, if required. */
 void
 miniroute_initialize() {
-    routing_cache = hashtable_init(SIZE_OF_ROUTE_CACHE, hash_wrapper, network_address_comparator);
+    if (route_cache_init(&routing_cache, SIZE_OF_ROUTE_CACHE) == -1) {
+        fprintf(stderr, "OUT OF MEMORY");
+        exit(-1);
+    }
     network_get_my_address(local_address);
 }
 
@@ -104,24 +101,69 @@ find_self(network_address_t *path) {
 }
 
 // evicts cache entry stored in arg
-// Does not check for threads blocked on semaphore before deallocation
+// Does not check for threads waiting on the entry before deallocation
 int
 cache_evict(void *arg) {
     route_cache_entry_t route = (route_cache_entry_t) arg;
     
-    semaphore_destroy(route->routing_sem);
-    free(hashtable_remove(routing_cache, (route->destination)));
+    condvar_destroy(route->routing_done);
+    route_cache_remove(&routing_cache, &route->destination, NULL);
     free(route);
     
     return 0;
 }
 
+// iterator callback for miniroute_flush_routes: drops resolved routes,
+// entries still being discovered have threads waiting on them
+static int
+flush_route(void *arg, const network_address_t *destination, route_cache_entry_t route) {
+    if (route->routing_flag == 1) {
+        deregister_alarm(route->alarm_id);
+        cache_evict(route);
+    }
+    return 0;
+}
+
+void
+miniroute_flush_routes() {
+    interrupt_level_t level;
+    
+    level = set_interrupt_level(DISABLED);
+    route_cache_iterate(&routing_cache, flush_route, NULL);
+    set_interrupt_level(level);
+}
+
+// iterator callback for miniroute_dump_routes
+static int
+dump_route(void *arg, const network_address_t *destination, route_cache_entry_t route) {
+    printf("route to ");
+    network_printaddr((void *) *destination);
+    printf(": %s, %d hops\n",
+           route->routing_flag == 1 ? "resolved" : "discovering", route->path_len);
+    return 0;
+}
+
+void
+miniroute_dump_routes() {
+    hashtable_stats_t stats;
+    interrupt_level_t level;
+    
+    level = set_interrupt_level(DISABLED);
+    route_cache_iterate(&routing_cache, dump_route, NULL);
+    route_cache_get_stats(&routing_cache, &stats);
+    set_interrupt_level(level);
+    printf("%u routes in %u slots, load %.2f, avg probe %.2f, max probe %u, %u collisions\n",
+           stats.size, stats.capacity, stats.load_factor, stats.avg_probe,
+           stats.max_probe, stats.collisions);
+}
+
 /*
  Called by network handler
  */
 void
 miniroute_helper(network_interrupt_arg_t *packet) {
     routing_header_t receivedheader, replyheader;
+    struct routing_header reply;
     char routing_type;
     network_address_t destination;
     unsigned int id;
@@ -153,7 +195,7 @@ miniroute_helper(network_interrupt_arg_t *packet) {
             // pack up and send reply
             path_len++;
             network_address_copy(local_address, path[path_len]);
-            replyheader = (routing_header_t) malloc(sizeof(struct routing_header));
+            replyheader = &reply;
             replyheader->routing_packet_type = ROUTING_ROUTE_REPLY;
             // Destination is the message initiator
             pack_address(replyheader->destination, path[0]);
@@ -165,7 +207,6 @@ miniroute_helper(network_interrupt_arg_t *packet) {
             pack_path(replyheader->path, replypath);
             
             network_send_pkt(replypath[1], sizeof(struct routing_header), (char *)replyheader, 0, &junk);
-            free(replyheader);
             free(packet);
             return;
         } else {
@@ -182,7 +223,7 @@ miniroute_helper(network_interrupt_arg_t *packet) {
                 // pack up and broadcast
                 path_len++;
                 network_address_copy(local_address, path[path_len]);
-                replyheader = (routing_header_t) malloc(sizeof(struct routing_header));
+                replyheader = &reply;
                 replyheader->routing_packet_type = ROUTING_ROUTE_DISCOVERY;
                 pack_address(replyheader->destination, destination);
                 pack_unsigned_int(replyheader->id, id);
@@ -191,7 +232,6 @@ miniroute_helper(network_interrupt_arg_t *packet) {
                 pack_path(replyheader->path, path);
                 
                 network_bcast_pkt(sizeof(struct routing_header), (char *)replyheader, 0, &junk);
-                free(replyheader);
                 free(packet);
                 return;
             }
@@ -202,7 +242,7 @@ miniroute_helper(network_interrupt_arg_t *packet) {
         if (network_address_same(destination, local_address)) {
             level = set_interrupt_level(DISABLED);
             // check cache, wake up threads if necessary
-            if (hashtable_get(routing_cache, path[0], &cache_entry)) {
+            if (route_cache_get(&routing_cache, &path[0], &cache_entry)) {
                 // cache entry not present, discard packet
                 free(packet);
                 set_interrupt_level(level);
@@ -224,10 +264,9 @@ miniroute_helper(network_interrupt_arg_t *packet) {
                 cache_entry->routing_flag = 1;
                 cache_entry->alarm_id = register_alarm(3000, cache_evict, cache_entry);
                 
-                if (cache_entry->waiting_count > 0) {
-                    semaphore_V(cache_entry->routing_sem);
-                }
+                condvar_broadcast(cache_entry->routing_done);
                 free(packet);
+                set_interrupt_level(level);
                 return;
             }
             set_interrupt_level(level);
@@ -238,7 +277,7 @@ miniroute_helper(network_interrupt_arg_t *packet) {
                 free(packet);
                 return;
             }
-            replyheader = (routing_header_t) malloc(sizeof(struct routing_header));
+            replyheader = &reply;
             replyheader->routing_packet_type = routing_type;
             pack_address(replyheader->destination, destination);
             pack_unsigned_int(replyheader->id, id);
@@ -248,7 +287,6 @@ miniroute_helper(network_interrupt_arg_t *packet) {
             
             network_send_pkt(path[find_self(path) + 1], sizeof(struct routing_header), (char *)replyheader, 0, &junk);
             
-            free(replyheader);
             free(packet);
             return;
         }
@@ -260,6 +298,7 @@ miniroute_helper(network_interrupt_arg_t *packet) {
 int
 forward_packet(network_interrupt_arg_t *packet) {
     routing_header_t receivedheader, replyheader;
+    struct routing_header forward;
     network_address_t destination;
     unsigned int id;
     unsigned int ttl;
@@ -279,7 +318,7 @@ forward_packet(network_interrupt_arg_t *packet) {
     unpack_path(receivedheader->path, path);
     
     ttl--;
-    replyheader = (routing_header_t) malloc(sizeof(struct routing_header));
+    replyheader = &forward;
     replyheader->routing_packet_type = ROUTING_DATA;
     pack_address(replyheader->destination, destination);
     pack_unsigned_int(replyheader->id, id);
@@ -289,9 +328,8 @@ forward_packet(network_interrupt_arg_t *packet) {
     
     // forward packet to next person in path
     network_send_pkt(path[find_self(path) + 1], sizeof(struct routing_header),
-                     (char *)replyheader, MAX_NETWORK_PKT_SIZE - sizeof(struct routing_header),
+                     (char *)replyheader, packet->size - sizeof(struct routing_header),
                      packet->buffer + sizeof(struct routing_header));
-    free(replyheader);
     free(packet);
     return 1;
 }
@@ -299,9 +337,13 @@ forward_packet(network_interrupt_arg_t *packet) {
 int
 rebroadcast(void *arg) {
     route_cache_entry_t route = (route_cache_entry_t) arg;
+    struct routing_header discovery;
     routing_header_t hdr;
     char junk;
+    interrupt_level_t level;
     
+    // retrieve_route inspects the entry with interrupts disabled
+    level = set_interrupt_level(DISABLED);
     (route->routing_id)++;
     
     // max retries, set flag and allow all threads to wake up and fail
@@ -309,17 +351,17 @@ rebroadcast(void *arg) {
         route->routing_flag = 2;
         
         if (route->waiting_count) {
-            semaphore_V(route->routing_sem);
-            return -1;
+            // the last waiter to wake up destroys the entry
+            condvar_broadcast(route->routing_done);
         } else {
             // no one is waiting for route, simply destroy the cache entry
-            semaphore_destroy(route->routing_sem);
-            free(hashtable_remove(routing_cache, (route->destination)));
-            free(route);
+            cache_evict(route);
         }
+        set_interrupt_level(level);
+        return -1;
     }
     
-    hdr = (routing_header_t) malloc(sizeof(struct routing_header));
+    hdr = &discovery;
     hdr->routing_packet_type = ROUTING_ROUTE_DISCOVERY;
     pack_address(hdr->destination, route->destination);
     // Is this right?
@@ -333,6 +375,7 @@ rebroadcast(void *arg) {
     route->alarm_id = register_alarm(15000, rebroadcast, route);
     
     (route->retry_count)++;
+    set_interrupt_level(level);
     
     return 0;
 }
@@ -344,84 +387,51 @@ rebroadcast(void *arg) {
 route_cache_entry_t
 retrieve_route(network_address_t dest_address) {
     route_cache_entry_t route;
+    interrupt_level_t level;
     
-    network_address_t *addr = malloc(sizeof(network_address_t));
-    network_address_copy(dest_address, *addr);
-    
-    if (hashtable_get(routing_cache, *addr, &route)) {
+    // the reply handler and rebroadcast alarm update the entry with interrupts disabled
+    level = set_interrupt_level(DISABLED);
+    // a parameter of array type is really a pointer to its first element
+    if (route_cache_get(&routing_cache, (network_address_t *) dest_address, &route)) {
         // item not present in hashtable so create a new entry
         route = (route_cache_entry_t) malloc(sizeof(struct route_cache_entry));
         network_address_copy(dest_address, route->destination);
         route->path_len = 0;
         memset(route->path, 0, MAX_ROUTE_LENGTH * 8);
         network_address_copy(local_address, route->path[0]);
-        route->routing_sem = semaphore_create();
-        semaphore_initialize(route->routing_sem, 0);
+        route->routing_done = condvar_create();
         route->waiting_count = 0;
         route->routing_flag = 0;
         route->alarm_id = -1;
         route->retry_count = 0;
         route->routing_id = 0;
         
-        hashtable_put(routing_cache, addr, route);
+        route_cache_put(&routing_cache, &route->destination, route);
         
         // now broadcast and sleep
         // further rebroadcasts are handled by alarm function
         rebroadcast(route);
+    }
+    
+    // routing in progress, wait for it to succeed or fail
+    if (route->routing_flag == 0) {
         (route->waiting_count)++;
-        semaphore_P(route->routing_sem);
-        (route->waiting_count)--;
-        if (route->waiting_count > 0) semaphore_V(route->routing_sem);
-        
-        if (route->routing_flag == 1) {
-            // routing succeeded
-            return route;
-        } else {
-            // routing has failed
-            return NULL;
+        while (route->routing_flag == 0) {
+            condvar_wait(route->routing_done, NULL);
         }
-    } else {
-        // routing in progress, wait for a return value
-        if (route->routing_flag == 0) {
-            (route->waiting_count)++;
-            semaphore_P(route->routing_sem);
-            (route->waiting_count)--;
-            if (route->waiting_count > 0) semaphore_V(route->routing_sem);
-            
-            if (route->routing_flag == 1) {
-                // routing succeeded
-                return route;
-            } else {
-                // routing has failed
-                if (route->waiting_count == 0) {
-                    semaphore_destroy(route->routing_sem);
-                    free(hashtable_remove(routing_cache, (route->destination)));
-                    free(route);
-                }
-                return NULL;
-            }
-        }
-        // route is present
-        if (route->routing_flag == 1) {
-            return route;
-        }
-        // fail immediately
-        if (route->routing_flag == 2) {
-            // threads still blocked on routing, V on sema and return
-            if (route->waiting_count > 0) {
-                semaphore_V(route->routing_sem);
-                return NULL;
-            } else {
-                // no threads blocked, destroy entry
-                semaphore_destroy(route->routing_sem);
-                free(hashtable_remove(routing_cache, (route->destination)));
-                free(route);
-                return NULL;
-            }
-        }
-        
-        return NULL;
+        (route->waiting_count)--;
     }
+    
+    if (route->routing_flag == 1) {
+        // routing succeeded
+        set_interrupt_level(level);
+        return route;
+    }
+    // routing has failed, the last thread out destroys the entry
+    if (route->waiting_count == 0) {
+        cache_evict(route);
+    }
+    set_interrupt_level(level);
     return NULL;
 }
 
@@ -433,30 +443,31 @@ miniroute_send_pkt(network_address_t dest_address, int hdr_len, char* hdr, int d
     route_cache_entry_t route;
     routing_header_t rhdr;
     int bytes_sent;
-    int size;
-    char nonroute_data[MAX_NETWORK_PKT_SIZE];
+    // the routing header and the caller's header go out as one piece and the
+    // payload as the other, so the payload is never copied
+    char headers[sizeof(struct routing_header) + MINIROUTE_MAX_HEADER_SIZE];
     network_address_t path[MAX_ROUTE_LENGTH];
     
-    memcpy(nonroute_data, hdr, hdr_len);
-    memcpy(nonroute_data + hdr_len, data, data_len);
-    size = hdr_len + data_len;
+    if (hdr_len < 0 || hdr_len > MINIROUTE_MAX_HEADER_SIZE) {
+        return -1;
+    }
+    rhdr = (routing_header_t) headers;
+    rhdr->routing_packet_type = ROUTING_DATA;
+    pack_address(rhdr->destination, dest_address);
+    pack_unsigned_int(rhdr->id, 0);
+    pack_unsigned_int(rhdr->ttl, MAX_ROUTE_LENGTH);
+    memcpy(headers + sizeof(struct routing_header), hdr, hdr_len);
     
     printf("Inside sendpkt\n");
     // send to self, don't check cache
     if (network_address_same(dest_address, local_address)) {
 		printf("Sending to myself\n");
-        rhdr = (routing_header_t) malloc(sizeof(struct routing_header));
-        rhdr->routing_packet_type = ROUTING_DATA;
-        pack_address(rhdr->destination, dest_address);
-        pack_unsigned_int(rhdr->id, 0);
-        pack_unsigned_int(rhdr->ttl, MAX_ROUTE_LENGTH);
         pack_unsigned_int(rhdr->path_len, 0);
         memset(path, 0, MAX_ROUTE_LENGTH * 8);
         network_address_copy(local_address, path[0]);
         pack_path(rhdr->path, path);
         
-        bytes_sent = network_send_pkt(local_address, sizeof(struct routing_header), (char *)rhdr, size, nonroute_data);
-        free(rhdr);
+        bytes_sent = network_send_pkt(local_address, sizeof(struct routing_header) + hdr_len, headers, data_len, data);
         return bytes_sent - sizeof(struct routing_header);
     }
     network_printaddr(dest_address);
@@ -467,20 +478,27 @@ miniroute_send_pkt(network_address_t dest_address, int hdr_len, char* hdr, int d
         return -1;  //should return value be 0?
     }
     
-    rhdr = (routing_header_t) malloc(sizeof(struct routing_header));
-    rhdr->routing_packet_type = ROUTING_DATA;
-    pack_address(rhdr->destination, dest_address);
-    pack_unsigned_int(rhdr->id, 0);
-    pack_unsigned_int(rhdr->ttl, MAX_ROUTE_LENGTH);
     pack_unsigned_int(rhdr->path_len, route->path_len);
     pack_path(rhdr->path, route->path);
     
     // send packet to first address in path
-    bytes_sent = network_send_pkt(route->path[1], sizeof(struct routing_header), (char *)rhdr, size, nonroute_data);
-    free(rhdr);
+    bytes_sent = network_send_pkt(route->path[1], sizeof(struct routing_header) + hdr_len, headers, data_len, data);
     return bytes_sent - sizeof(struct routing_header);
 }
 
+int
+miniroute_route_cached(network_address_t dest_address) {
+    route_cache_entry_t route;
+    
+    if (network_address_same(dest_address, local_address)) {
+        return 1;
+    }
+    if (route_cache_get(&routing_cache, (network_address_t *) dest_address, &route)) {
+        return 0;
+    }
+    return route->routing_flag == 1;
+}
+
 /* hashes a pointer to a network_address_t into a 16 bit unsigned int */
 unsigned short
 hash_address(network_address_t address) {
@@ -11,6 +11,8 @@ enum routing_packet_type {
 
 #define MAX_ROUTE_LENGTH 20
 #define SIZE_OF_ROUTE_CACHE 20
+/* largest protocol header miniroute_send_pkt accepts in front of the payload */
+#define MINIROUTE_MAX_HEADER_SIZE 64
 
 
 typedef struct routing_header
@@ -43,9 +45,31 @@ void miniroute_initialize();
  *
  * All calls to network_send_pkt in the previous code should be replaced with calls to this function instead.
  *
+ * The routing header and hdr (at most MINIROUTE_MAX_HEADER_SIZE bytes) are combined on the stack and handed
+ * to network_send_pkt together with data, so the payload is sent from the caller's buffer without a copy.
+ *
  */
 int miniroute_send_pkt(network_address_t dest_address, int hdr_len, char* hdr, int data_len, char* data);
 
+/*
+ * Returns 1 if miniroute_send_pkt can send to dest_address without running route discovery, 0 otherwise.
+ * Callers that must not block, such as alarm handlers, check this first. Must be called with interrupts
+ * disabled, and the answer only holds until they are enabled again, as the route may expire.
+ */
+int miniroute_route_cached(network_address_t dest_address);
+
+
+/*
+ * Drop every resolved route from the route cache, for instance after the topology has changed, so that
+ * the next packet to each destination runs route discovery again. Discoveries in progress are left alone.
+ */
+void miniroute_flush_routes();
+
+/*
+ * Print every route in the route cache together with the cache's probe statistics, to size
+ * SIZE_OF_ROUTE_CACHE from measurement.
+ */
+void miniroute_dump_routes();
 
 /* 
  * hash function that generates an unsigned short integer value from a given network address. This value will
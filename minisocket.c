@@ -8,38 +8,65 @@
 #include "alarm.h"
 #include "queue.h"
 #include "synch.h"
+#include "waitqueue.h"
+#include "packet_pool.h"
 
 enum SOCKET_STATE {
 	START, LISTENING, CONNECTING, CONNECTED, CLOSING, CLOSED
 };
 
+/*
+ * A fragment sent but not yet acknowledged. Its data stays in the buffer
+ * passed to minisocket_send, which does not return before it is acknowledged.
+ */
+struct send_segment {
+	int seq;
+	int offset; // of the data within the message being sent
+	int length;
+	int sacked; // the peer holds it out of order, no need to resend
+	char *data;
+};
+
+typedef struct stream_data {
+	struct queue_node link; // links the segment into the receive buffer
+	int seq;
+	int length;
+	int offset;
+	char *data;
+} *stream_data_t;
+
 struct minisocket
 {
     int remote_port;
     int local_port;
-	int seq;
-	int ack;
+	int seq; // last sequence number sent
+	int ack; // last sequence number received in order
+	int acked; // highest sequence number the peer has acknowledged
+	int window;
+	int rtt_seq; // segment being timed, 0 if none
+	long rtt_start; // tick it was sent
+	minisocket_stats_t stats; // also holds the live RTT and congestion state
+	int cwnd_count; // acks counted towards the next congestion avoidance increase
+	int recover; // last segment sent before the latest timeout
+	int resend; // next segment up to recover that may need resending
+	long rto_deadline; // tick the oldest unacknowledged segment is resent at, -1 if none
+	int ack_pending; // in-order segments received but not acknowledged yet
+	int ack_alarm; // delayed ack timer, -1 if not running
+	struct send_segment unacked[MINISOCKET_MAX_WINDOW]; // indexed by seq % MINISOCKET_MAX_WINDOW
+	stream_data_t reorder[MINISOCKET_MAX_WINDOW]; // segments after ack, indexed like unacked
 	int state;
 	int timed_out;
 	int tries;
 	minisocket_error error;
     queue_t incoming_data;
-    queue_t alarms;
 	queue_t buffer;
     network_address_t src_addr;
     network_address_t dest_addr;
 	semaphore_t data_available;
 	semaphore_t buffer_has_stuff;
 	semaphore_t unable_to_close;
-	semaphore_t listening;
 };
 
-typedef struct stream_data {
-	int length;
-	int offset;
-	char *data;
-} *stream_data_t;
-
 int MY_DEBUG = 0;
 
 minisocket_t ports[SOCKET_SERVER_MAX + 1];
@@ -72,25 +99,42 @@ int reclaim_port(int port) {
 	return queue_append(client_free_ports, (void *)port);
 }
 
-int
-send_data_packet( minisocket_t socket, int message_type, int data_len, char *data) {
-    mini_header_reliable_t header;
+/* Every packet carries our ack number, so sending anything settles a
+   delayed ack. Senders run with interrupts enabled, while the network
+   handler and the alarm thread start and end the timer. */
+static void
+cancel_delayed_ack(minisocket_t socket) {
+    interrupt_level_t level;
+
+    level = set_interrupt_level(DISABLED);
+    if (socket->ack_alarm != -1) {
+        deregister_alarm(socket->ack_alarm);
+        socket->ack_alarm = -1;
+    }
+    socket->ack_pending = 0;
+    set_interrupt_level(level);
+}
+
+static int
+send_packet(minisocket_t socket, int message_type, int seq, int data_len, char *data) {
+    struct mini_header_reliable reliable;
+    mini_header_reliable_t header = &reliable;
+    interrupt_level_t level;
     int sent;
     
-    header = (mini_header_reliable_t)malloc(sizeof(struct mini_header_reliable));
-    if(header == NULL) {
-        socket->error = SOCKET_OUTOFMEMORY;
-        free(header);
-        return -1;
-    }
     header->protocol = PROTOCOL_MINISTREAM;
     pack_address(header->source_address, socket->src_addr);
     pack_unsigned_short(header->source_port, socket->local_port);
     pack_address(header->destination_address, socket->dest_addr);
     pack_unsigned_short(header->destination_port, socket->remote_port);
     header->message_type = (char)message_type;
-    pack_unsigned_int(header->seq_number, socket->seq);
+    pack_unsigned_int(header->seq_number, seq);
+    // read the ack and settle the pending one together, so an ack arriving
+    // in between is neither lost nor left with a timer we no longer know of
+    level = set_interrupt_level(DISABLED);
     pack_unsigned_int(header->ack_number, socket->ack);
+    cancel_delayed_ack(socket);
+    set_interrupt_level(level);
     
     sent = miniroute_send_pkt(socket->dest_addr, MINISTREAM_HEADER_SIZE,
                             (char *) header, data_len, data);
@@ -98,84 +142,307 @@ send_data_packet( minisocket_t socket, int message_type, int data_len, char *dat
     if(sent == -1) {
         socket->error = SOCKET_SENDERROR;
     }  
-    free(header);
     return sent;
 }
 
+int
+send_data_packet( minisocket_t socket, int message_type, int data_len, char *data) {
+    return send_packet(socket, message_type, socket->seq, data_len, data);
+}
+
+static int
+send_segment(minisocket_t socket, struct send_segment *segment) {
+    socket->stats.segments_sent++;
+    return send_packet(socket, MSG_ACK, segment->seq, segment->length, segment->data);
+}
+
 int send_control_packet(minisocket_t socket, int message_type) {
 	return send_data_packet(socket, message_type, 0, NULL);
 }
 
-typedef struct wake_arg {
-	int alarm_id;
-	minisocket_t socket;
-	semaphore_t sema;
-} *wake_arg_t;
+/* Bitmap of the segments held in the reassembly buffer, as sent in a SACK */
+unsigned int sack_bits(minisocket_t socket) {
+	unsigned int bits;
+	int i;
 
-int wake_from_timeout(wake_arg_t arg) {
-	if (arg == NULL || arg->sema == NULL || arg->socket == NULL) {
-		print_debug("!!! Null argument in wake_from_timeout !!!");
-		return -1;
+	bits = 0;
+	for (i = 0; i < MINISOCKET_MAX_WINDOW - 1; i++) {
+		if (socket->reorder[(socket->ack + 2 + i) % MINISOCKET_MAX_WINDOW] != NULL) {
+			bits |= 1U << i;
+		}
 	}
-	arg->socket->timed_out = 1;
-	semaphore_V(arg->sema);
+	return bits;
+}
+
+/* Acknowledge everything received in order, and with a SACK anything held
+   in the reassembly buffer beyond it */
+void send_ack(minisocket_t socket) {
+	char sack[MINISTREAM_SACK_SIZE];
+	unsigned int bits;
+
+	bits = sack_bits(socket);
+	if (bits == 0) {
+		send_control_packet(socket, MSG_ACK);
+	} else {
+		pack_unsigned_int(sack, bits);
+		send_data_packet(socket, MSG_SACK, MINISTREAM_SACK_SIZE, sack);
+	}
+}
+
+/* Alarm handler sending an ack that was held back too long. It runs on the
+   alarm thread, which must not block in route discovery: without a cached
+   route the ack stays pending and goes out with the next packet we send, or
+   when the peer resends and its duplicate is acknowledged at once. */
+int delayed_ack_expire(minisocket_t socket) {
+	interrupt_level_t level;
+
+	level = set_interrupt_level(DISABLED);
+	// the alarm slot is already free, do not let send_ack deregister it
+	socket->ack_alarm = -1;
+	if (socket->ack_pending > 0 && miniroute_route_cached(socket->dest_addr)) {
+		send_ack(socket);
+	}
+	set_interrupt_level(level);
 	return 0;
 }
 
-/* Wakes up any thread waiting on the socket */
-void wake_from_packet(minisocket_t socket) {
-	wake_arg_t arg;
+/* Acknowledge an in-order segment, holding the ack back until a second
+   segment arrives, we send something it can ride on, or the timer runs out */
+void delay_ack(minisocket_t socket) {
+	socket->ack_pending++;
+	if (socket->ack_pending >= MINISOCKET_ACK_EVERY) {
+		send_ack(socket);
+	} else if (socket->ack_alarm == -1) {
+		socket->ack_alarm = register_alarm(DELAYED_ACK_TIMEOUT, (proc_t)delayed_ack_expire, (arg_t)socket);
+		if (socket->ack_alarm == -1) {
+			send_ack(socket);
+		}
+	}
+}
 
-	socket->timed_out = 0;
-	queue_dequeue(socket->alarms, (void **)&arg);
-	if (arg != NULL) {
-		semaphore_V(arg->sema);
+/* Store a data segment that falls inside the receive window, pass on to the
+   receive buffer whatever is now in order and acknowledge. */
+void receive_segment(minisocket_t socket, int seq, char *data, int length) {
+	stream_data_t item;
+	int was_empty, old_ack;
+
+	if (socket->reorder[seq % MINISOCKET_MAX_WINDOW] == NULL) {
+		// segment and its data share one pooled buffer
+		item = (stream_data_t)packet_pool_alloc(sizeof(struct stream_data) + length);
+		if (item == NULL) {
+			// drop it, the peer will resend
+			send_ack(socket);
+			return;
+		}
+		item->seq = seq;
+		item->length = length;
+		item->offset = 0;
+		item->data = (char*)(item + 1);
+		memcpy(item->data, data, length);
+		socket->reorder[seq % MINISOCKET_MAX_WINDOW] = item;
+	}
+	was_empty = queue_length(socket->buffer) == 0;
+	old_ack = socket->ack;
+	while ((item = socket->reorder[(socket->ack + 1) % MINISOCKET_MAX_WINDOW]) != NULL) {
+		socket->reorder[item->seq % MINISOCKET_MAX_WINDOW] = NULL;
+		queue_link_init(&item->link, item);
+		queue_append_link(socket->buffer, &item->link);
+		socket->ack = item->seq;
+	}
+	if (was_empty && queue_length(socket->buffer) > 0) {
+		semaphore_V(socket->buffer_has_stuff);
+	}
+	// gaps and segments that fill one are acknowledged at once, so the
+	// sender learns about them without waiting
+	if (socket->ack == old_ack + 1 && seq == socket->ack && sack_bits(socket) == 0) {
+		delay_ack(socket);
+	} else {
+		send_ack(socket);
+	}
+}
+
+/* Mark the segments a SACK reports as received, so they are not resent */
+void receive_sack(minisocket_t socket, int ack, unsigned int bits) {
+	struct send_segment *segment;
+	int i;
+
+	for (i = 0; i < MINISOCKET_MAX_WINDOW - 1 && ack + 2 + i <= socket->seq; i++) {
+		segment = &socket->unacked[(ack + 2 + i) % MINISOCKET_MAX_WINDOW];
+		if ((bits & (1U << i)) && segment->seq == ack + 2 + i) {
+			segment->sacked = 1;
+		}
+	}
+}
+
+void release_reorder_buffer(minisocket_t socket) {
+	stream_data_t item;
+	int i;
+
+	for (i = 0; i < MINISOCKET_MAX_WINDOW; i++) {
+		packet_pool_free(socket->reorder[i]);
+		socket->reorder[i] = NULL;
+	}
+	// segments delivered but never read hold pooled buffers too
+	while (queue_dequeue(socket->buffer, (void **)&item) == 0) {
+		packet_pool_free(item);
+	}
+}
+
+/* Fold a round trip time sample into the estimates and recompute the
+   retransmission timeout, RFC 6298 style */
+void sample_rtt(minisocket_t socket, int rtt) {
+	int granularity;
+	int delta;
+
+	granularity = (int)(PERIOD / MILLISECOND);
+	if (socket->stats.srtt == -1) {
+		socket->stats.srtt = rtt;
+		socket->stats.rttvar = rtt / 2;
+	} else {
+		delta = socket->stats.srtt > rtt ? socket->stats.srtt - rtt : rtt - socket->stats.srtt;
+		socket->stats.rttvar = (3 * socket->stats.rttvar + delta) / 4;
+		socket->stats.srtt = (7 * socket->stats.srtt + rtt) / 8;
+	}
+	socket->stats.rto = socket->stats.srtt +
+		(4 * socket->stats.rttvar > granularity ? 4 * socket->stats.rttvar : granularity);
+	// the peer may hold an ack back for DELAYED_ACK_TIMEOUT, never time out first
+	if (socket->stats.rto < DELAYED_ACK_TIMEOUT + granularity) {
+		socket->stats.rto = DELAYED_ACK_TIMEOUT + granularity;
+	}
+	if (socket->stats.rto > MAX_TIMEOUT) {
+		socket->stats.rto = MAX_TIMEOUT;
+	}
+}
+
+/* Advance the peer's cumulative ack, timing the round trip if it covers the
+   segment being timed */
+void acknowledge(minisocket_t socket, int ack) {
+	int newly_acked;
+
+	// grow the congestion window, exponentially below ssthresh, linearly above
+	for (newly_acked = ack - socket->acked; newly_acked > 0; newly_acked--) {
+		if (socket->stats.cwnd < socket->stats.ssthresh) {
+			socket->stats.cwnd++;
+		} else if (++socket->cwnd_count >= socket->stats.cwnd) {
+			socket->stats.cwnd++;
+			socket->cwnd_count = 0;
+		}
 	}
+	if (socket->stats.cwnd > MINISOCKET_MAX_WINDOW) {
+		socket->stats.cwnd = MINISOCKET_MAX_WINDOW;
+	}
+	socket->acked = ack;
+	if (socket->rtt_seq != 0 && ack >= socket->rtt_seq) {
+		sample_rtt(socket, (int)((ticks - socket->rtt_start) * (double)(PERIOD / MILLISECOND)));
+		socket->rtt_seq = 0;
+	}
+}
+
+/* Segments that may be in flight: the configured window, but no more than
+   the congestion window */
+int send_window(minisocket_t socket) {
+	return socket->window < socket->stats.cwnd ? socket->window : socket->stats.cwnd;
 }
 
-int delete_by_id(wake_arg_t arg, int *id) {
-	return arg->alarm_id == *id ? 0 : -1;
+/* Take a timeout as a sign of congestion: shrink the windows and start
+   resending what was in flight */
+void congestion_timeout(minisocket_t socket) {
+	socket->stats.ssthresh = (socket->seq - socket->acked) / 2;
+	if (socket->stats.ssthresh < 2) {
+		socket->stats.ssthresh = 2;
+	}
+	socket->stats.cwnd = 1;
+	socket->cwnd_count = 0;
+	socket->recover = socket->seq;
+	socket->resend = socket->acked + 1;
+}
+
+/* Resend segments that were in flight at the last timeout, as far as the
+   congestion window allows, skipping any the peer reported holding */
+void resend_lost(minisocket_t socket) {
+	struct send_segment *segment;
+
+	if (socket->resend <= socket->acked) {
+		socket->resend = socket->acked + 1;
+	}
+	while (socket->resend <= socket->recover &&
+		socket->resend - socket->acked <= send_window(socket)) {
+		segment = &socket->unacked[socket->resend % MINISOCKET_MAX_WINDOW];
+		if (!segment->sacked) {
+			socket->stats.retransmissions++;
+			send_segment(socket, segment);
+		}
+		socket->resend++;
+	}
+}
+
+/* Current timeout, doubled for each consecutive timeout so far */
+int retransmit_timeout(minisocket_t socket) {
+	int timeout;
+
+	timeout = socket->stats.rto << socket->tries;
+	return timeout > MAX_TIMEOUT || timeout <= 0 ? MAX_TIMEOUT : timeout;
+}
+
+/* Wakes up any thread waiting on the socket */
+void wake_from_packet(minisocket_t socket) {
+	socket->timed_out = 0;
+	waitqueue_wake(socket, 1);
 }
 
 /* This function will block until the socket times out
    or a packet of interest comes in */
 void waiT(minisocket_t socket) {
-	int timeout, alarm_id;
-	semaphore_t sema;
-	wake_arg_t arg;
+	int timeout;
+	interrupt_level_t level;
+
+	level = set_interrupt_level(DISABLED);
+	timeout = retransmit_timeout(socket);
+	socket->timed_out = waitqueue_wait(socket, timeout);
+	set_interrupt_level(level);
+}
+
+/* (Re)start the retransmission timer of the data in flight */
+void arm_retransmit(minisocket_t socket) {
+	long delay;
+
+	delay = (long)((double)retransmit_timeout(socket) / (double)(PERIOD / MILLISECOND));
+	socket->rto_deadline = ticks + (delay > 0 ? delay : 1);
+}
+
+/* Block until the peer acknowledges more than acked or the retransmission
+   deadline passes. The deadline belongs to the flight, not to this wait,
+   so wakes that bring no new ack do not push it back. Returns at once if
+   an ack arrived since the caller last looked. */
+void wait_for_ack(minisocket_t socket, int acked) {
 	interrupt_level_t level;
 
 	level = set_interrupt_level(DISABLED);
-	arg = (wake_arg_t)malloc(sizeof(struct wake_arg));
-	sema = semaphore_create();
-	arg->socket = socket;
-	arg->sema = sema;
-	timeout = BASE_TIMEOUT * (1 << socket->tries);
-	alarm_id = register_alarm(timeout, (proc_t)wake_from_timeout, (arg_t)arg);
-	arg->alarm_id = alarm_id;
-	queue_append(socket->alarms, (void *)arg);
-
-	semaphore_P(sema);
-
-	deregister_alarm(arg->alarm_id);
-	queue_delete_by_predicate(socket->alarms, (PFany)delete_by_id, &arg->alarm_id);
-	semaphore_destroy(arg->sema);
-	free(arg);
+	socket->timed_out = 0;
+	while (socket->acked == acked && socket->acked != socket->seq && !socket->timed_out) {
+		if (ticks >= socket->rto_deadline) {
+			socket->timed_out = 1;
+		} else {
+			waitqueue_wait(socket, (int)((socket->rto_deadline - ticks) * (double)(PERIOD / MILLISECOND)));
+		}
+	}
 	set_interrupt_level(level);
 }
 
+/* Blocks until a SYN moves the socket out of LISTENING */
 void listen_wait(minisocket_t socket) {
-	if (socket->listening == NULL) {
-		socket->listening = semaphore_create();
+	interrupt_level_t level;
+
+	level = set_interrupt_level(DISABLED);
+	while (socket->state == LISTENING) {
+		waitqueue_wait(socket, -1);
 	}
-	semaphore_P(socket->listening);
-	semaphore_destroy(socket->listening);
-	socket->listening = NULL;
+	set_interrupt_level(level);
 }
 
 void listen_wake(minisocket_t socket) {
 	socket->timed_out = 0;
-	semaphore_V(socket->listening);
+	waitqueue_wake(socket, 1);
 }
 
 int minisocket_handle_incoming_packet(int port, network_interrupt_arg_t *packet) {
@@ -183,25 +450,80 @@ int minisocket_handle_incoming_packet(int port, network_interrupt_arg_t *packet)
 	int message_type;
 	mini_header_reliable_t header;
 	stream_data_t item;
+	int length, seq, ack, pure_ack, in_order;
+	char *payload;
 	interrupt_level_t level;
 	
 	level = set_interrupt_level(DISABLED);
-	header = (mini_header_reliable_t)(packet->buffer + sizeof(struct routing_header));
 	socket = ports[port];
     if(socket == NULL || packet == NULL) {
+        free(packet);
+        set_interrupt_level(level);
         return -1;
     }
+	header = (mini_header_reliable_t)(packet->buffer + sizeof(struct routing_header));
 	message_type = header->message_type;
-	printf("Packet seq: %d ack: %d type: %d\n", unpack_unsigned_int(header->seq_number), unpack_unsigned_int(header->ack_number), message_type);
+	seq = unpack_unsigned_int(header->seq_number);
+	ack = unpack_unsigned_int(header->ack_number);
+	printf("Packet seq: %d ack: %d type: %d\n", seq, ack, message_type);
 	print_status(socket);
-	if (!(unpack_unsigned_int(header->seq_number) == socket->ack + 1 ||
-		((message_type == MSG_ACK || message_type == MSG_SYNACK) && packet->size - MINISTREAM_HEADER_SIZE - sizeof(struct routing_header) == 0 && unpack_unsigned_int(header->ack_number) == socket->seq))) {
+	payload = packet->buffer + sizeof(struct routing_header) + MINISTREAM_HEADER_SIZE;
+	length = packet->size - MINISTREAM_HEADER_SIZE - sizeof(struct routing_header);
+	pure_ack = (message_type == MSG_ACK || message_type == MSG_SYNACK) && length == 0;
+
+	if (message_type == MSG_SACK) {
+		if (socket->state == CONNECTED && length >= MINISTREAM_SACK_SIZE &&
+			ack >= socket->acked && ack <= socket->seq) {
+			acknowledge(socket, ack);
+			receive_sack(socket, ack, unpack_unsigned_int(payload));
+			wake_from_packet(socket);
+		}
+		free(packet);
+		set_interrupt_level(level);
+		return 0;
+	}
+	// data carries the peer's cumulative ack too
+	if (socket->state == CONNECTED && message_type == MSG_ACK && length > 0 &&
+		ack > socket->acked && ack <= socket->seq) {
+		acknowledge(socket, ack);
+		// the data itself may yet be rejected, the sender must hear of the ack anyway
+		wake_from_packet(socket);
+	}
+	// data anywhere in the receive window is kept, in order or not
+	if ((socket->state == CONNECTED || socket->state == CONNECTING) &&
+		message_type == MSG_ACK && length > 0 &&
+		seq > socket->ack && seq <= socket->ack + MINISOCKET_MAX_WINDOW) {
+		if (socket->state == CONNECTING) {
+			// the final ack of the handshake was lost, the data implies it
+			print_debug("Handler received data in Connecting");
+			socket->state = CONNECTED;
+			socket->acked = socket->seq;
+		}
+		print_debug("Got some data");
+		receive_segment(socket, seq, payload, length);
+		free(packet);
+		set_interrupt_level(level);
+		return 0;
+	}
+	// a pure ack carries the peer's last sequence number, not a new one
+	in_order = seq == socket->ack + 1 && !(message_type == MSG_ACK && pure_ack);
+	// acknowledgements are cumulative, any ack for data still in flight counts
+	if (!(in_order ||
+		(pure_ack && ack >= socket->acked && ack <= socket->seq))) {
 
 		print_debug("Received bad packet");
-		send_control_packet(socket, MSG_ACK);
+		// repeat our cumulative ack so the peer resends what we are missing
+		send_ack(socket);
+		free(packet);
+		set_interrupt_level(level);
 		return -1;
 	}
-	socket->ack = unpack_unsigned_int(header->seq_number);
+	if (in_order) {
+		socket->ack = seq;
+	}
+	if (pure_ack && ack > socket->acked && ack <= socket->seq) {
+		acknowledge(socket, ack);
+	}
 	switch (socket->state) {
 	case START:
 		break;
@@ -241,20 +563,8 @@ int minisocket_handle_incoming_packet(int port, network_interrupt_arg_t *packet)
 			send_control_packet(socket, MSG_ACK);
 			break;
 		case MSG_ACK:
+			// data was taken care of above, this only acknowledges ours
 			print_debug("Handler received ACK in Connected");
-			if (packet->size - MINISTREAM_HEADER_SIZE > 0) { // there's stuff in there
-				print_debug("Got some data");
-				item = (stream_data_t)malloc(sizeof(struct stream_data));
-				item->length = packet->size - MINISTREAM_HEADER_SIZE - sizeof(struct routing_header);
-				item->offset = 0;
-				item->data = (char*)malloc(sizeof(char) * item->length);
-				memcpy(item->data, packet->buffer + MINISTREAM_HEADER_SIZE + sizeof(struct routing_header), item->length);
-				queue_append(socket->buffer, item);
-				if (queue_length(socket->buffer) == 1) { // it was previously empty
-					semaphore_V(socket->buffer_has_stuff);
-				}
-				send_control_packet(socket, MSG_ACK);
-			}
 			wake_from_packet(socket);
 			break;
 		case MSG_FIN:
@@ -285,18 +595,12 @@ int minisocket_handle_incoming_packet(int port, network_interrupt_arg_t *packet)
 }
 
 void minisocket_free(minisocket_t socket) {
-	int alarm_id;
 	interrupt_level_t level;
 
-	level = set_interrupt_level(level);
-    if(socket->alarms!= NULL) {
-        while (queue_length(socket->alarms) > 0) {
-            queue_dequeue(socket->alarms, (void **)&alarm_id);
-            deregister_alarm(alarm_id);
-        }
-    }
+	level = set_interrupt_level(DISABLED);
+	cancel_delayed_ack(socket);
+	release_reorder_buffer(socket);
 	queue_free(socket->incoming_data);
-    queue_free(socket->alarms);
 	queue_free(socket->buffer);
 	semaphore_destroy(socket->data_available);
 	semaphore_destroy(socket->buffer_has_stuff);
@@ -318,20 +622,36 @@ create_new_socket(int remote_port, int local_port, int starting_state, minisocke
     socket->local_port = local_port;
 	socket->seq = 1;
 	socket->ack = 0;
+	socket->acked = 0;
+	socket->window = MINISOCKET_WINDOW;
+	socket->rtt_seq = 0;
+	socket->rtt_start = 0;
+	socket->stats.srtt = -1;
+	socket->stats.rttvar = -1;
+	socket->stats.rto = BASE_TIMEOUT;
+	socket->stats.segments_sent = 0;
+	socket->stats.retransmissions = 0;
+	// enough for the receiver to ack at once instead of waiting on its timer
+	socket->stats.cwnd = MINISOCKET_ACK_EVERY;
+	socket->stats.ssthresh = MINISOCKET_MAX_WINDOW;
+	socket->cwnd_count = 0;
+	socket->recover = 0;
+	socket->resend = 1;
+	socket->rto_deadline = -1;
+	socket->ack_pending = 0;
+	socket->ack_alarm = -1;
+	memset(socket->reorder, 0, sizeof(socket->reorder));
 	socket->state = starting_state;
 	socket->tries = 0;
 	socket->timed_out = 0;
 	socket->error = SOCKET_NOERROR;
 	socket->incoming_data = queue_new();
-    socket->alarms = queue_new();
 	socket->buffer = queue_new();
 	socket->buffer_has_stuff = semaphore_create();
 	socket->data_available = semaphore_create();
 	socket->unable_to_close = NULL;
-	socket->listening = NULL;
 	if (socket->incoming_data == NULL ||
 		socket->data_available == NULL || 
-		socket->alarms == NULL ||
 		socket->buffer == NULL ||
 		socket->buffer_has_stuff == NULL) {
 
@@ -404,7 +724,7 @@ minisocket_server_create(int port, minisocket_error *error)
 		if (socket->state == LISTENING) {
 			listen_wait(socket);
 		} else {
-			wait(socket);
+			waiT(socket);
 		}
 		if (socket->timed_out) {
 			socket->tries++;
@@ -485,7 +805,7 @@ minisocket_client_create(network_address_t addr, int port, minisocket_error *err
 	socket->state = CONNECTING;
 
     while (socket->state != CONNECTED && socket->error == SOCKET_NOERROR) {
-		wait(socket);
+		waiT(socket);
 		if (socket->timed_out) {
 			socket->tries++;
 			socket->timed_out = 0;
@@ -539,41 +859,102 @@ minisocket_client_create(network_address_t addr, int port, minisocket_error *err
  */
 int minisocket_send(minisocket_t socket, minimsg_t msg, int len, minisocket_error *error)
 {
-	int remaining, fragment_length;
+	struct send_segment *segment;
+	int sent, acknowledged, fragment_length, acked;
 
-	// verify that the socket is connected
-	if (len < 0 || msg == NULL || socket == NULL || socket->state != CONNECTED) {
+	// verify that the socket is connected and has nothing left over from a failed send
+	if (len < 0 || msg == NULL || socket == NULL || socket->state != CONNECTED ||
+		socket->acked != socket->seq) {
 		*error = SOCKET_SENDERROR;
 		return -1;
 	}
-	remaining = len;
-	while (remaining > 0 && *error == SOCKET_NOERROR) {
-		if (remaining + MINISTREAM_HEADER_SIZE + sizeof(struct routing_header) > MAX_NETWORK_PKT_SIZE) {
-			fragment_length = MAX_NETWORK_PKT_SIZE - MINISTREAM_HEADER_SIZE - sizeof(struct routing_header);
-		} else {
-			fragment_length = remaining;
-		}
-		if (socket->tries == 0) {
+	sent = 0;
+	acknowledged = 0;
+	socket->tries = 0;
+	while (acknowledged < len && *error == SOCKET_NOERROR) {
+		acked = socket->acked;
+		// fill the window with new fragments
+		while (sent < len && socket->seq - socket->acked < send_window(socket)) {
+			if (len - sent + MINISTREAM_HEADER_SIZE + sizeof(struct routing_header) > MAX_NETWORK_PKT_SIZE) {
+				fragment_length = MAX_NETWORK_PKT_SIZE - MINISTREAM_HEADER_SIZE - sizeof(struct routing_header);
+			} else {
+				fragment_length = len - sent;
+			}
 			print_debug("Sending new data");
 			socket->seq++;
+			segment = &socket->unacked[socket->seq % MINISOCKET_MAX_WINDOW];
+			segment->seq = socket->seq;
+			segment->offset = sent;
+			segment->length = fragment_length;
+			segment->sacked = 0;
+			segment->data = msg + sent;
+			if (socket->rtt_seq == 0) {
+				socket->rtt_seq = segment->seq;
+				socket->rtt_start = ticks;
+			}
+			send_segment(socket, segment);
+			sent += fragment_length;
+			if (socket->rto_deadline == -1) {
+				arm_retransmit(socket);
+			}
 		}
-        send_data_packet(socket, MSG_ACK, fragment_length, msg + (len - remaining));
-		wait(socket);
-		if (socket->timed_out) {
-			socket->tries++;
-			socket->timed_out = 0;
-			print_debug("Send timed out");
-		} else {
+		// wait only while there is nothing more to send
+		if (sent == len || socket->seq - socket->acked >= send_window(socket)) {
+			wait_for_ack(socket, acked);
+			if (socket->timed_out) {
+				socket->tries++;
+				socket->timed_out = 0;
+				print_debug("Send timed out");
+				// Karn: an ack for a resent segment says nothing about the round trip
+				socket->rtt_seq = 0;
+				congestion_timeout(socket);
+				arm_retransmit(socket);
+			}
+		}
+		// only progress clears the backoff and restarts the timer
+		if (socket->acked != acked) {
 			socket->tries = 0;
-			socket->timed_out = 0;
-			remaining -= fragment_length;
+			if (socket->acked == socket->seq) {
+				socket->rto_deadline = -1;
+			} else {
+				arm_retransmit(socket);
+			}
+		}
+		// resend what was lost at the last timeout as the window reopens
+		resend_lost(socket);
+		if (socket->acked == socket->seq) {
+			acknowledged = sent;
+		} else {
+			acknowledged = socket->unacked[(socket->acked + 1) % MINISOCKET_MAX_WINDOW].offset;
 		}
 		if (socket->tries > MAX_TRIES) {
 			*error = SOCKET_SENDERROR;
 		}
 	}
-    printf("Sent is %d\n", len-remaining);
-	return len - remaining;
+    printf("Sent is %d\n", acknowledged);
+	return acknowledged;
+}
+
+int minisocket_set_window(minisocket_t socket, int window)
+{
+	if (socket == NULL || window < 1 || window > MINISOCKET_MAX_WINDOW) {
+		return -1;
+	}
+	socket->window = window;
+	return 0;
+}
+
+int minisocket_get_stats(minisocket_t socket, minisocket_stats_t *stats)
+{
+	interrupt_level_t level;
+
+	if (socket == NULL || stats == NULL) {
+		return -1;
+	}
+	level = set_interrupt_level(DISABLED);
+	*stats = socket->stats;
+	set_interrupt_level(level);
+	return 0;
 }
 
 /*
@@ -611,14 +992,13 @@ int minisocket_receive(minisocket_t socket, minimsg_t msg, int max_len, minisock
 		received += size;
 		if (item->length - item->offset - size > 0) {
 			item->offset = item->offset + size;
-			if (queue_prepend(socket->buffer, (void *)item) == -1) {
+			if (queue_prepend_link(socket->buffer, &item->link) == -1) {
                 set_interrupt_level(level);
 				*error = SOCKET_RECEIVEERROR;
 				return -1;
 			}
         } else {
-			free(item->data);
-			free(item);
+			packet_pool_free(item);
 		}
 	}
 	if (queue_length(socket->buffer) > 0) {
@@ -636,7 +1016,6 @@ int minisocket_receive(minisocket_t socket, minimsg_t msg, int max_len, minisock
 void minisocket_close(minisocket_t socket)
 {
 	interrupt_level_t level;
-    int alarm_id;
 
 	// Set state to closing, which should fail any send or receive
 	level = set_interrupt_level(DISABLED);
@@ -653,7 +1032,7 @@ void minisocket_close(minisocket_t socket)
 	// send fin and wait for finack if possible
 	while (socket->state != CLOSED && socket->tries <= MAX_TRIES) {
 		send_control_packet(socket, MSG_FIN);
-		wait(socket);
+		waiT(socket);
 		if (socket->timed_out) {
 			socket->tries++;
 			socket->timed_out = 0;
@@ -666,14 +1045,9 @@ void minisocket_close(minisocket_t socket)
 	if (socket->local_port <= SOCKET_CLIENT_MAX) {
 		reclaim_port(socket->local_port);
 	}
-	if(socket->alarms!= NULL) {
-        while (queue_length(socket->alarms) > 0) {
-            queue_dequeue(socket->alarms, (void **)&alarm_id);
-            deregister_alarm(alarm_id);
-        }
-    }
+	cancel_delayed_ack(socket);
+	release_reorder_buffer(socket);
 	queue_free(socket->incoming_data);
-    queue_free(socket->alarms);
 	queue_free(socket->buffer);
 	semaphore_destroy(socket->data_available);
 	semaphore_destroy(socket->buffer_has_stuff);
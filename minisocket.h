@@ -19,10 +19,29 @@
 #define SOCKET_SERVER_MAX 65535
 #define MAX_TRIES 6
 #define BASE_TIMEOUT 100
+#define MINISOCKET_WINDOW 8 /* fragments a new socket keeps in flight */
+#define MINISOCKET_MAX_WINDOW 32
+#define MAX_TIMEOUT (BASE_TIMEOUT << MAX_TRIES) /* cap on a backed-off timeout */
+#define DELAYED_ACK_TIMEOUT 50 /* longest an ack for in-order data is held back */
+#define MINISOCKET_ACK_EVERY 2 /* in-order segments acknowledged at once */
 
 typedef struct minisocket* minisocket_t;
 typedef enum minisocket_error minisocket_error;
 
+/*
+ * Transmission statistics of a socket, see minisocket_get_stats. Times are in
+ * milliseconds; srtt and rttvar are -1 until the first round trip is timed.
+ */
+typedef struct minisocket_stats {
+  int srtt;             /* smoothed round trip time */
+  int rttvar;           /* round trip time variation */
+  int rto;              /* retransmission timeout before backoff */
+  int segments_sent;    /* data segments sent, including retransmissions */
+  int retransmissions;  /* data segments sent again after a timeout */
+  int cwnd;             /* congestion window, in segments */
+  int ssthresh;         /* slow start threshold, in segments */
+} minisocket_stats_t;
+
 
 enum minisocket_error {
   SOCKET_NOERROR=0,
@@ -89,6 +108,31 @@ minisocket_t minisocket_client_create(network_address_t addr, int port, minisock
  */
 int minisocket_send(minisocket_t socket, minimsg_t msg, int len, minisocket_error *error);
 
+/*
+ * Set how many fragments 'minisocket_send' may have in flight on the socket
+ * before it waits for an acknowledgement, between 1 (stop-and-wait) and
+ * MINISOCKET_MAX_WINDOW. Takes effect from the next fragment sent.
+ * This is an upper bound: fewer are sent while the congestion window is
+ * smaller. The congestion window grows by one segment per acknowledged
+ * segment (slow start) up to the slow start threshold and by one segment
+ * per window's worth of acknowledgements after that. A timeout halves the
+ * threshold to what was in flight and drops the congestion window to one
+ * segment.
+ * Return value: 0 on success, -1 if the socket or window is invalid.
+ */
+int minisocket_set_window(minisocket_t socket, int window);
+
+/*
+ * Fill in stats with the socket's round trip estimates and counters.
+ * The retransmission timeout starts at BASE_TIMEOUT and then follows the
+ * measured round trip time (Jacobson's algorithm, timing only segments that
+ * were never retransmitted, as Karn suggests), but never drops below
+ * DELAYED_ACK_TIMEOUT plus one clock tick. Every consecutive timeout
+ * doubles it, up to MAX_TIMEOUT.
+ * Return value: 0 on success, -1 if an argument is NULL.
+ */
+int minisocket_get_stats(minisocket_t socket, minisocket_stats_t *stats);
+
 /*
  * Receive a message from the other end of the socket. Blocks until max_len
  * bytes or a full message is received (which can be smaller than max_len
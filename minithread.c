@@ -22,8 +22,12 @@
 #include "minimsg.h"
 #include "miniheader.h"
 #include "minisocket.h"
+#include "waitqueue.h"
 
 #include <assert.h>
+#ifdef TICKLESS_IDLE
+#include <signal.h>
+#endif
 
 /*
  * A minithread should be defined either in this file or in a private
@@ -36,29 +40,43 @@
 struct minithread {
 	int thread_id;
 	int priority;
+	enum thread_policy policy;
 	enum status status;
     stack_pointer_t stackbase;
     stack_pointer_t stacktop;
+    stack_pointer_t stackinit; // stacktop as allocated, restored when the stack is reused
+	struct queue_node link; // links the thread on ready/wait/delete queues
+	struct waitqueue_node wait; // parks the thread on a keyed wait queue
 };
 
+/*
+ * The reaper is only woken once REAPER_THRESHOLD dead threads have piled up
+ * on the delete queue, or when the system goes idle, and then drains the
+ * whole queue in one go.
+ */
+#define REAPER_THRESHOLD 8
+
 minithread_t reaper_thread;// the reaper thread who cleans dead threads
 semaphore_t schedule_reaper_thread;
+int reaper_signalled; // 1 while a wakeup of the reaper is pending
 
 // the queue where dead threads go into once they finish executing finalproc
 queue_t delete_queue;
 
+// reaped threads kept with their stacks for minithread_create to reuse
+queue_t thread_cache;
+int thread_cache_size = DEFAULT_THREAD_CACHE_SIZE;
+
 minithread_t active_thread; // the currently running thread
+int next_thread_id; // identifier given to the next thread created
 
-queue_t alarm_queue;
 minithread_t alarm_thread;
 semaphore_t alarm_sema;
 
 int finalproc(arg_t);
 int reap_proc(arg_t);
-int update_alarm_item_delay(void* , void* );
-int trigger_alarm(void* ,void* );
+void wake_reaper(int);
 int alarm_proc(int* arg);
-void minithread_wake(semaphore_t);
 int minithread_get_status(minithread_t);
 
 
@@ -66,6 +84,16 @@ int minithread_get_status(minithread_t thread) {
     return thread->status;
 }
 
+q_node_t
+minithread_queue_link(minithread_t thread) {
+	return &thread->link;
+}
+
+waitqueue_node_t
+minithread_wait_node(minithread_t thread) {
+	return &thread->wait;
+}
+
 /* Interrupt handlers */
 
 /*
@@ -78,9 +106,20 @@ clock_handler(void* arg) {
     interrupt_level_t l;
     l = set_interrupt_level(DISABLED);
     ticks += 1;
+    // wake the alarm thread once for everything that fell due since the last turn
+    if (alarm_advance() > 0) {
+        semaphore_V(alarm_sema);
+    }
+#ifdef TICKLESS_IDLE
+    // idle with nothing to run: there is no quantum to account or preempt
+    if (minithread_self() -> status == IDLE && scheduler_size() == 0) {
+        scheduler_record_idle_tick();
+        set_interrupt_level(l);
+        return;
+    }
+#endif
 	scheduler_advance();
-    queue_iterate(alarm_queue, &trigger_alarm, NULL);
-    
+
 	if (scheduler_quota_expired()) {
         minithread_yield();
 	}
@@ -123,8 +162,10 @@ network_handler(void *arg) {
         set_interrupt_level(level);
     } else {
         // return if packet was data packet not meant for me
-		printf("forward %d\n",forward_packet(interrupt));
-        if (forward_packet(interrupt)) return;
+        if (forward_packet(interrupt)) {
+            set_interrupt_level(level);
+            return;
+        }
         
         // Find the protocol first
         dataheader = (mini_header_t) (interrupt->buffer + sizeof(struct routing_header));
@@ -164,23 +205,46 @@ void disk_handler(void* arg) {
 
 /* minithread functions */
 
+void
+minithread_set_thread_cache_size(int size) {
+	thread_cache_size = size < 0 ? 0 : size;
+}
+
 /*
  * The create function allocates and initializes stack for the new thread.
+ * A thread recycled by the reaper is reused when one is cached, in which
+ * case only its stack is re-initialized.
  */
 minithread_t
 minithread_create(proc_t proc, arg_t arg) {
-	minithread_t new_thread;
+	minithread_t new_thread = NULL;
+    interrupt_level_t level;
+
+    level = set_interrupt_level(DISABLED);
+    queue_dequeue(thread_cache, (void **)&new_thread);
+    set_interrupt_level(level);
 
-    new_thread = (minithread_t)malloc(sizeof(struct minithread));
     if (NULL == new_thread) {
-        fprintf(stderr, "NO MEMORY!!!");
-		return NULL;
+        new_thread = (minithread_t)malloc(sizeof(struct minithread));
+        if (NULL == new_thread) {
+            fprintf(stderr, "NO MEMORY!!!");
+            return NULL;
+        }
+        minithread_allocate_stack(&(new_thread -> stackbase), &(new_thread -> stacktop));
+        new_thread -> stackinit = new_thread -> stacktop;
+    } else {
+        new_thread -> stacktop = new_thread -> stackinit;
     }
-    minithread_allocate_stack(&(new_thread -> stackbase), &(new_thread -> stacktop));
 	minithread_initialize_stack(&(new_thread -> stacktop), proc, arg, &finalproc, (arg_t)new_thread);
     // initialize with lowest priority possible
+    level = set_interrupt_level(DISABLED);
+    new_thread->thread_id = ++next_thread_id;
+    set_interrupt_level(level);
 	new_thread->priority = 0;
+	new_thread->policy = THREAD_FEEDBACK;
 	new_thread->status = OK;
+	queue_link_init(&new_thread->link, new_thread);
+	waitqueue_node_init(&new_thread->wait, new_thread);
     return new_thread;
 }
 
@@ -212,11 +276,39 @@ minithread_id() {
     return minithread_self()->thread_id;
 }
 
+int
+minithread_get_id(minithread_t thread) {
+    return thread->thread_id;
+}
+
 int
 minithread_priority(minithread_t thread) {
 	return thread->priority;
 }
 
+int
+minithread_set_priority(minithread_t thread, int priority) {
+	if (thread == NULL || priority < 0 || priority >= MINITHREAD_PRIORITIES) {
+		return -1;
+	}
+	thread->priority = priority;
+	return 0;
+}
+
+int
+minithread_set_policy(minithread_t thread, enum thread_policy policy) {
+	if (thread == NULL || (policy != THREAD_FEEDBACK && policy != THREAD_REALTIME)) {
+		return -1;
+	}
+	thread->policy = policy;
+	return 0;
+}
+
+enum thread_policy
+minithread_policy(minithread_t thread) {
+	return thread->policy;
+}
+
 /* DEPRECATED. Beginning from project 2, you should use minithread_unlock_and_stop() instead
  * of this function.
  */
@@ -247,12 +339,16 @@ minithread_yield() {
     level = set_interrupt_level(DISABLED);
     running_thread = minithread_self();
     priority = running_thread->priority;
-    if (scheduler_quota_expired()) {
-		// demote
-        running_thread->priority = priority + 1 > 3 ? 3 : priority + 1;
-    } else {
-		// promote
-        running_thread->priority = priority - 1 > 0 ? priority - 1 : 0;
+    // real-time threads keep the priority they were given
+    if (running_thread->policy == THREAD_FEEDBACK) {
+        if (scheduler_quota_expired()) {
+            // demote
+            running_thread->priority = priority + 1 >= MINITHREAD_PRIORITIES ? MINITHREAD_PRIORITIES - 1 : priority + 1;
+        } else {
+            // promote
+            running_thread->priority = priority - 1 > 0 ? priority - 1 : 0;
+        }
+        scheduler_record_priority_change(priority, running_thread->priority);
     }
     if(scheduler_schedule(running_thread) == -1) {
         fprintf(stderr, "Cannot schedule minithread onto ready queue\n");
@@ -260,6 +356,9 @@ minithread_yield() {
 
     next_thread = scheduler_next_thread();
     active_thread = next_thread;
+    if (next_thread != running_thread) {
+        scheduler_record_switch(running_thread, next_thread);
+    }
     
     minithread_switch(&running_thread->stacktop, &next_thread->stacktop);
     
@@ -286,10 +385,10 @@ minithread_unlock_and_stop(tas_lock_t* lock) {
 void
 minithread_sleep_with_timeout(int delay) {
     interrupt_level_t level;
-    semaphore_t sleeping = semaphore_create();
+
+    // nobody else wakes a thread on its own key, so this only ends by timing out
     level = set_interrupt_level(DISABLED);
-    register_alarm(delay, (proc_t)&minithread_wake, (arg_t)sleeping);
-    semaphore_P(sleeping);
+    waitqueue_wait(minithread_self(), delay);
     set_interrupt_level(level);
 }
 
@@ -312,6 +411,9 @@ minithread_system_initialize(proc_t mainproc, arg_t mainarg) {
 	minithread_t main_thread, idle_thread;
     network_address_t addr;
     disk_t* disk;
+#ifdef TICKLESS_IDLE
+    sigset_t blocked, unblocked;
+#endif
     
     disk = (disk_t*) malloc(sizeof(disk_t));
     if(disk == NULL) {
@@ -324,20 +426,24 @@ minithread_system_initialize(proc_t mainproc, arg_t mainarg) {
 	idle_thread -> stackbase = NULL;
 	idle_thread -> stacktop = NULL;
 	idle_thread -> priority = 0;
+	idle_thread -> policy = THREAD_FEEDBACK;
 	idle_thread -> status = IDLE;
+	queue_link_init(&idle_thread -> link, idle_thread);
+	waitqueue_node_init(&idle_thread -> wait, idle_thread);
     
     //initialize ready and delete queues
 	scheduler_initialize();
 	scheduler_set_idle(idle_thread);
 	delete_queue = queue_new();
-    alarm_queue = init_alarm_queue();
+	thread_cache = queue_new();
     
-    if (NULL == delete_queue || NULL == alarm_queue) {
+    if (NULL == delete_queue || NULL == thread_cache || init_alarm_wheel() == -1) {
         fprintf(stderr, "OUT OF MEMORY!\n");
         exit(-1);
     }
     
     schedule_reaper_thread = semaphore_create();
+    reaper_signalled = 0;
     alarm_sema = semaphore_create();
     
     minimsg_initialize();
@@ -345,8 +451,15 @@ minithread_system_initialize(proc_t mainproc, arg_t mainarg) {
 
 	//create global system threads
     main_thread = minithread_create(mainproc, mainarg);
-	reaper_thread = minithread_fork(reap_proc, NULL);
-    alarm_thread = minithread_fork(alarm_proc, NULL);
+	// system threads run in the real-time band so compute threads cannot delay them
+	reaper_thread = minithread_create(reap_proc, NULL);
+    alarm_thread = minithread_create(alarm_proc, NULL);
+    minithread_set_policy(alarm_thread, THREAD_REALTIME);
+    minithread_set_priority(alarm_thread, 0);
+    minithread_set_policy(reaper_thread, THREAD_REALTIME);
+    minithread_set_priority(reaper_thread, MINITHREAD_PRIORITIES - 1);
+    minithread_start(reaper_thread);
+    minithread_start(alarm_thread);
     
     active_thread = main_thread;
     
@@ -358,6 +471,19 @@ minithread_system_initialize(proc_t mainproc, arg_t mainarg) {
     minithread_switch(&(idle_thread -> stacktop), &(main_thread -> stacktop));
     
 	while(1) {
+        // nothing else is runnable, so reap whatever has died so far
+        wake_reaper(1);
+#ifdef TICKLESS_IDLE
+        // sleep until the next interrupt instead of spinning through yields;
+        // signals stay blocked from the check until sigsuspend waits, so an
+        // interrupt that makes a thread runnable in between is not slept through
+        sigfillset(&blocked);
+        sigprocmask(SIG_BLOCK, &blocked, &unblocked);
+        if (scheduler_size() == 0) {
+            sigsuspend(&unblocked);
+        }
+        sigprocmask(SIG_SETMASK, &unblocked, NULL);
+#endif
         minithread_yield();
     }
 }
@@ -378,10 +504,11 @@ finalproc(arg_t final) {
 	thread->status = DESTROYED;
     assert(thread != NULL);
     level = set_interrupt_level(DISABLED);
-    assert(queue_append(delete_queue, thread) != -1) ;
-    set_interrupt_level(level);
-    //signal the reaper thread to schedule
-    semaphore_V(schedule_reaper_thread);
+    if (queue_append_link(delete_queue, &thread->link) == -1) {
+        fprintf(stderr, "Could not append thread to delete queue\n");
+    }
+    //signal the reaper thread to schedule once enough threads are dead
+    wake_reaper(REAPER_THRESHOLD);
     
 	minithread_yield();
 
@@ -390,58 +517,64 @@ finalproc(arg_t final) {
     return 0;
 }
 
-int
-trigger_alarm(void* item, void* alarm_queue_item) {
-    if(ticks == alarm_get_delay((alarm_item_t)alarm_queue_item)) {
-        semaphore_V(alarm_sema);
-		return 0;
-    }
-	return -1;
-}
-
+/*
+ * The alarm thread sleeps until the clock handler reports that alarms fell due,
+ * then runs every due alarm in one wakeup.
+ */
 int
 alarm_proc(int* arg) {
-    alarm_item_t spawn_alarm;
-	interrupt_level_t level;
     while(1) {
-        level = set_interrupt_level(DISABLED);
         semaphore_P(alarm_sema);
-        //TODO make wrapper to dequeue the queue
-        assert(queue_dequeue(alarm_queue, (void **)&spawn_alarm) != 1);
-        set_interrupt_level(level);
-        alarm_get_func(spawn_alarm)(alarm_get_func_arg(spawn_alarm));
+        alarm_fire_expired();
     }
 }
 
+/*
+ * Wake the reaper if at least threshold dead threads are waiting and it has
+ * not been woken already.
+ */
 void
-minithread_wake(semaphore_t sleeping) {
-	interrupt_level_t l;
+wake_reaper(int threshold) {
+    interrupt_level_t level;
 
-	l = set_interrupt_level(DISABLED);
-    semaphore_V(sleeping);
-	set_interrupt_level(l);
-    semaphore_destroy(sleeping);
+    level = set_interrupt_level(DISABLED);
+    if (!reaper_signalled && queue_length(delete_queue) >= threshold) {
+        reaper_signalled = 1;
+        semaphore_V(schedule_reaper_thread);
+    }
+    set_interrupt_level(level);
 }
 
 /*
  * The reap_proc is the process called when the reaper_thread starts executing.
- * It manages the delete_queue, in that, it removes stale threads by freeing their stack and 
- * the pointers. Then it switches back to the idle thread once it is done with reaping.
+ * It manages the delete_queue, in that, it drains every stale thread in one wakeup,
+ * moving them onto the thread cache while there is room. The rest are collected
+ * and their stacks and pointers freed together with interrupts enabled.
+ * Then it switches back to the idle thread once it is done with reaping.
  */
 int
 reap_proc(int* arg) {
     minithread_t item;
+    queue_t release;
     interrupt_level_t level;
 
+    release = queue_new();
+    assert(release != NULL);
     while(1) {
         semaphore_P(schedule_reaper_thread);
         level = set_interrupt_level(DISABLED);
-        if(queue_dequeue(delete_queue, (void **)&item) == -1) {
-            fprintf(stderr, "Could not remove item from delete queue\n");
+        reaper_signalled = 0;
+        while (queue_dequeue(delete_queue, (void **)&item) == 0) {
+            if (queue_length(thread_cache) < thread_cache_size) {
+                queue_append_link(thread_cache, &item->link);
+            } else {
+                queue_append_link(release, &item->link);
+            }
         }
         set_interrupt_level(level);
-        assert(item!= NULL);
-        minithread_free_stack(item->stackbase);
-        free(item);
+        while (queue_dequeue(release, (void **)&item) == 0) {
+            minithread_free_stack(item->stackbase);
+            free(item);
+        }
     }
 }
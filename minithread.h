@@ -2,6 +2,7 @@
 #define __MINITHREAD_H__
 
 #include "machineprimitives.h"
+#include "queue.h"
 
 /*
  * minithread.h:
@@ -24,6 +25,21 @@ enum status {
 	OK, DESTROYED, SLEEPING, IDLE
 };
 
+/*
+ * enumeration thread_policy:
+ * FEEDBACK threads are scheduled by the scheduler's policy and have their
+ * priority adjusted by minithread_yield. REALTIME threads keep the priority
+ * they are given and are always run before any FEEDBACK thread, highest
+ * priority (0) first.
+ */
+
+enum thread_policy {
+	THREAD_FEEDBACK, THREAD_REALTIME
+};
+
+/* priorities range from 0 (highest) to MINITHREAD_PRIORITIES - 1 in both bands */
+#define MINITHREAD_PRIORITIES 4
+
 /*
  * struct minithread:
  *	This is the key data structure for the thread management package.
@@ -64,6 +80,11 @@ extern minithread_t minithread_self();
  */
 extern int minithread_id();
 
+/*
+ * Return the identifier of thread. The idle thread is 0.
+ */
+extern int minithread_get_id(minithread_t thread);
+
 /*
  * Return the priority of thread, 0-3
  */
@@ -71,6 +92,38 @@ extern int minithread_priority(minithread_t thread);
 
 extern int minithread_get_status(minithread_t thread);
 
+/*
+ * Set the priority of thread, 0 to MINITHREAD_PRIORITIES - 1. A REALTIME
+ * thread is pinned to it; a FEEDBACK thread starts from it. A thread that is
+ * already queued moves the next time it is scheduled.
+ * Return 0 (success) or -1 (failure).
+ */
+extern int minithread_set_priority(minithread_t thread, int priority);
+
+/*
+ * Move thread to the FEEDBACK or REALTIME band. A thread that is already
+ * queued moves the next time it is scheduled.
+ * Return 0 (success) or -1 (failure).
+ */
+extern int minithread_set_policy(minithread_t thread, enum thread_policy policy);
+
+/*
+ * Return the scheduling band of thread.
+ */
+extern enum thread_policy minithread_policy(minithread_t thread);
+
+/*
+ * Return the queue node embedded in thread. A thread is on at most one of the
+ * ready, semaphore wait or delete queues at a time, so these queues link threads
+ * through this node instead of allocating one per enqueue.
+ */
+extern q_node_t minithread_queue_link(minithread_t thread);
+
+/*
+ * Return the keyed wait queue node embedded in thread (see waitqueue.h).
+ */
+extern struct waitqueue_node* minithread_wait_node(minithread_t thread);
+
 /*
  * minithread_stop()
  * DEPRECATED. Beginning from project 2, you should use minithread_unlock_and_stop() instead
@@ -91,6 +144,19 @@ extern void minithread_start(minithread_t t);
  */
 extern void minithread_yield();
 
+/*
+ * Number of exited threads whose control block and stack are kept for reuse
+ * by later forks, unless changed with minithread_set_thread_cache_size.
+ */
+#define DEFAULT_THREAD_CACHE_SIZE 32
+
+/*
+ * minithread_set_thread_cache_size(int size)
+ *	Bound the cache of recycled threads. Must be called before
+ *	minithread_system_initialize, which sizes the cache; 0 disables it.
+ */
+extern void minithread_set_thread_cache_size(int size);
+
 /*
  * minithread_system_initialize(proc_t mainproc, arg_t mainarg)
  *	Initialize the system to run the first minithread at
@@ -9,21 +9,61 @@
 struct multilevel_queue {
 	int number_of_levels;
 	int size;
+	unsigned int occupied; // bit i is set while level i is non-empty
 	queue_t *levels; // array of pointers to queues
 };
 
+/* bit position of each isolated bit, indexed by its de Bruijn product */
+static const int debruijn_position[32] = {
+	0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+	31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
+/*
+ * Return the index of the lowest set bit of a non-zero word.
+ */
+static int
+lowest_set_bit(unsigned int word) {
+	return debruijn_position[(((word & (~word + 1)) * 0x077CB531U) & 0xffffffffU) >> 27];
+}
+
+/*
+ * Return the first non-empty level at or after level, wrapping around, by
+ * rotating the occupancy bitmap so that level becomes bit 0.
+ * The queue must not be empty.
+ */
+static int
+next_occupied_level(multilevel_queue_t queue, int level) {
+	unsigned int rotated;
+	int levels = queue->number_of_levels;
+
+	rotated = queue->occupied >> level;
+	if (level > 0) {
+		rotated |= queue->occupied << (levels - level);
+	}
+	if (levels < MULTILEVEL_QUEUE_MAX_LEVELS) {
+		rotated &= (1U << levels) - 1;
+	}
+	return (level + lowest_set_bit(rotated)) % levels;
+}
+
 /*
  * Returns an empty multilevel queue with number_of_levels levels. On error should return NULL.
  */
 multilevel_queue_t
 multilevel_queue_new(int number_of_levels) {
 	int i;
-	multilevel_queue_t queue = (multilevel_queue_t)malloc(sizeof(struct multilevel_queue));
+	multilevel_queue_t queue;
+	if (number_of_levels < 1 || number_of_levels > MULTILEVEL_QUEUE_MAX_LEVELS) {
+		return NULL;
+	}
+	queue = (multilevel_queue_t)malloc(sizeof(struct multilevel_queue));
 	if (queue == NULL) {
 		return NULL;
 	}
 	queue->number_of_levels = number_of_levels;
 	queue->size = 0;
+	queue->occupied = 0;
 	queue->levels = (queue_t *)malloc(number_of_levels * sizeof(queue_t));
 	if (queue->levels == NULL) {
 		return NULL;
@@ -43,13 +83,31 @@ multilevel_queue_new(int number_of_levels) {
 int
 multilevel_queue_enqueue(multilevel_queue_t queue, int level, void* item) {
 	int success;
-	if (queue == NULL || level < 0 || level > queue->number_of_levels) {
+	if (queue == NULL || level < 0 || level >= queue->number_of_levels) {
 		return -1;
 	}
 	success = queue_append(queue->levels[level], item);
 	if (success == -1) {
 		return -1;
 	}
+	queue->occupied |= 1U << level;
+	queue->size += 1;
+	return 0;
+}
+
+/*
+ * Appends an embedded queue node to the multilevel queue at the specified level.
+ * Return 0 (success) or -1 (failure).
+ */
+int
+multilevel_queue_enqueue_link(multilevel_queue_t queue, int level, q_node_t link) {
+	if (queue == NULL || level < 0 || level >= queue->number_of_levels) {
+		return -1;
+	}
+	if (queue_append_link(queue->levels[level], link) == -1) {
+		return -1;
+	}
+	queue->occupied |= 1U << level;
 	queue->size += 1;
 	return 0;
 }
@@ -62,20 +120,30 @@ multilevel_queue_enqueue(multilevel_queue_t queue, int level, void* item) {
  */
 int
 multilevel_queue_dequeue(multilevel_queue_t queue, int level, void** item) {
-	if (queue == NULL || queue->size == 0) {
+	if (queue == NULL || queue->size == 0 || level < 0 || level >= queue->number_of_levels) {
 		*item = NULL;
 		return -1;
 	}
-	for (*item = NULL; *item == NULL; ) {
-		queue_dequeue(queue->levels[level], item);
-		if (*item == NULL) {
-			level = (level + 1) % queue->number_of_levels;
-		}
+	level = next_occupied_level(queue, level);
+	queue_dequeue(queue->levels[level], item);
+	if (queue_length(queue->levels[level]) == 0) {
+		queue->occupied &= ~(1U << level);
 	}
 	queue->size -= 1;
 	return level;
 }
 
+/*
+ * Return the number of items at the specified level, or -1 (failure).
+ */
+int
+multilevel_queue_length_at(multilevel_queue_t queue, int level) {
+	if (queue == NULL || level < 0 || level >= queue->number_of_levels) {
+		return -1;
+	}
+	return queue_length(queue->levels[level]);
+}
+
 /* 
  * Free the queue and return 0 (success) or -1 (failure). Do not free the queue nodes; this is
  * the responsibility of the programmer.
@@ -14,7 +14,14 @@
 typedef struct multilevel_queue* multilevel_queue_t;
 
 /*
- * Returns an empty multilevel queue with number_of_levels levels. On error should return NULL.
+ * The levels that hold items are tracked in a one-word bitmap, which bounds
+ * the number of levels.
+ */
+#define MULTILEVEL_QUEUE_MAX_LEVELS 32
+
+/*
+ * Returns an empty multilevel queue with number_of_levels levels, at most
+ * MULTILEVEL_QUEUE_MAX_LEVELS. On error should return NULL.
  */
 extern multilevel_queue_t multilevel_queue_new(int number_of_levels);
 
@@ -23,6 +30,12 @@ extern multilevel_queue_t multilevel_queue_new(int number_of_levels);
  */
 extern int multilevel_queue_enqueue(multilevel_queue_t queue, int level, void* item);
 
+/*
+ * Appends an embedded queue node (see queue_link_init) to the multilevel queue at the
+ * specified level without allocating. Return 0 (success) or -1 (failure).
+ */
+extern int multilevel_queue_enqueue_link(multilevel_queue_t queue, int level, q_node_t link);
+
 /*
  * Dequeue and return the first void* from the multilevel queue starting at the specified level. 
  * Levels wrap around so as long as there is something in the multilevel queue an item should be returned.
@@ -31,6 +44,11 @@ extern int multilevel_queue_enqueue(multilevel_queue_t queue, int level, void* i
  */
 extern int multilevel_queue_dequeue(multilevel_queue_t queue, int level, void** item);
 
+/*
+ * Return the number of items at the specified level, or -1 (failure).
+ */
+extern int multilevel_queue_length_at(multilevel_queue_t queue, int level);
+
 /* 
  * Free the queue and return 0 (success) or -1 (failure). Do not free the queue nodes; this is
  * the responsibility of the programmer.
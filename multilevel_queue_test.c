@@ -62,6 +62,52 @@ test_dequeue_wrap() {
 	multilevel_queue_free(queue);
 }
 
+void
+test_dequeue_skips_empty_levels() {
+	multilevel_queue_t queue;
+	int x, y, z, level;
+	void *out;
+
+	x = 1;
+	y = 2;
+	z = 3;
+	queue = multilevel_queue_new(MULTILEVEL_QUEUE_MAX_LEVELS);
+	multilevel_queue_enqueue(queue, 5, &x);
+	multilevel_queue_enqueue(queue, 31, &y);
+	multilevel_queue_enqueue(queue, 31, &z);
+	level = multilevel_queue_dequeue(queue, 6, &out);
+	assert(*(int*)out == 2);
+	assert(level == 31);
+	level = multilevel_queue_dequeue(queue, 0, &out);
+	assert(*(int*)out == 1);
+	assert(level == 5);
+	level = multilevel_queue_dequeue(queue, 6, &out);
+	assert(*(int*)out == 3);
+	assert(level == 31);
+	level = multilevel_queue_dequeue(queue, 6, &out);
+	assert(out == NULL);
+	assert(level == -1);
+	multilevel_queue_free(queue);
+}
+
+void
+test_length_at() {
+	multilevel_queue_t queue;
+	int x;
+	void *out;
+
+	x = 1;
+	queue = multilevel_queue_new(4);
+	multilevel_queue_enqueue(queue, 2, &x);
+	multilevel_queue_enqueue(queue, 2, &x);
+	assert(multilevel_queue_length_at(queue, 2) == 2);
+	assert(multilevel_queue_length_at(queue, 0) == 0);
+	assert(multilevel_queue_length_at(queue, 4) == -1);
+	multilevel_queue_dequeue(queue, 0, &out);
+	assert(multilevel_queue_length_at(queue, 2) == 1);
+	multilevel_queue_free(queue);
+}
+
 void
 main() {
 	fprintf(stdout, "Testing multilevel_queue\n");
@@ -69,5 +115,7 @@ main() {
 	test_dequeue_empty();
 	test_dequeue_level_empty();
 	test_dequeue_wrap();
+	test_dequeue_skips_empty_levels();
+	test_length_at();
 	fprintf(stdout, "Done!\n");
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+ * Packet buffer pool implementation.
+ *
+ * Every buffer is preceded by a small header recording its size class, so
+ * packet_pool_free needs no size. While a buffer sits on a free list the same
+ * header links it to the next one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "interrupts.h"
+#include "packet_pool.h"
+
+typedef union packet_pool_header {
+	union packet_pool_header* next; // next free buffer of the class
+	int size_class;
+	double align; // keep the buffer after the header suitably aligned
+} *packet_pool_header_t;
+
+int packet_pool_sizes[PACKET_POOL_CLASSES] = {64, 256, 1024, MAX_NETWORK_PKT_SIZE};
+packet_pool_header_t packet_pool_free_list[PACKET_POOL_CLASSES];
+int packet_pool_free_count[PACKET_POOL_CLASSES];
+
+void*
+packet_pool_alloc(int size) {
+	packet_pool_header_t header;
+	interrupt_level_t level;
+	int size_class;
+
+	if (size < 0) {
+		return NULL;
+	}
+	for (size_class = 0; size_class < PACKET_POOL_CLASSES; size_class++) {
+		if (size <= packet_pool_sizes[size_class]) {
+			break;
+		}
+	}
+	if (size_class == PACKET_POOL_CLASSES) {
+		return NULL;
+	}
+
+	level = set_interrupt_level(DISABLED);
+	header = packet_pool_free_list[size_class];
+	if (header != NULL) {
+		packet_pool_free_list[size_class] = header->next;
+		packet_pool_free_count[size_class]--;
+	}
+	set_interrupt_level(level);
+
+	if (header == NULL) {
+		header = (packet_pool_header_t) malloc(sizeof(union packet_pool_header) + packet_pool_sizes[size_class]);
+		if (header == NULL) {
+			fprintf(stderr, "NO MEMORY");
+			return NULL;
+		}
+	}
+	header->size_class = size_class;
+	return header + 1;
+}
+
+void
+packet_pool_free(void* buffer) {
+	packet_pool_header_t header;
+	interrupt_level_t level;
+	int size_class;
+
+	if (buffer == NULL) {
+		return;
+	}
+	header = (packet_pool_header_t) buffer - 1;
+	size_class = header->size_class;
+
+	level = set_interrupt_level(DISABLED);
+	if (packet_pool_free_count[size_class] < PACKET_POOL_MAX_FREE) {
+		header->next = packet_pool_free_list[size_class];
+		packet_pool_free_list[size_class] = header;
+		packet_pool_free_count[size_class]++;
+		header = NULL;
+	}
+	set_interrupt_level(level);
+
+	// the class already keeps enough spare buffers
+	if (header != NULL) {
+		free(header);
+	}
+}
@@ -0,0 +1,31 @@
+/*
+ * Packet buffer pool.
+ */
+#ifndef __PACKET_POOL_H__
+#define __PACKET_POOL_H__
+
+#include "network.h"
+
+/*
+ * Buffers are handed out from per-size-class free lists. A buffer freed back
+ * to the pool is kept on its class's list for the next allocation of that
+ * class, up to PACKET_POOL_MAX_FREE buffers per class, so once traffic has
+ * warmed the pool up, allocating and freeing packet buffers no longer touches
+ * malloc. The largest class holds a whole network packet.
+ */
+#define PACKET_POOL_CLASSES 4
+#define PACKET_POOL_MAX_FREE 64
+
+/*
+ * Return a buffer of at least size bytes, or NULL if size is larger than
+ * MAX_NETWORK_PKT_SIZE or memory runs out. Safe to call from interrupt
+ * handlers.
+ */
+extern void* packet_pool_alloc(int size);
+
+/*
+ * Return a buffer obtained from packet_pool_alloc to the pool.
+ */
+extern void packet_pool_free(void* buffer);
+
+#endif __PACKET_POOL_H__
@@ -6,15 +6,6 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
-/*
- * q_node_t is a pointer to
- */
-typedef struct queue_node {
-	void* data;
-	struct queue_node* prev;
-	struct queue_node* next;
-} *q_node_t;
-
 /*
  * queue_t is a pointer to
  */
@@ -24,6 +15,29 @@ struct queue {
     int q_length;
 };
 
+/*
+ * Allocate a node for an item the client did not supply a node for.
+ */
+static q_node_t
+node_new(void* item) {
+	q_node_t node = (q_node_t)malloc(sizeof(struct queue_node));
+	if (node != NULL) {
+		node -> data = item;
+		node -> embedded = 0;
+	}
+	return node;
+}
+
+/*
+ * Free a node unless the client owns it.
+ */
+static void
+node_release(q_node_t node) {
+	if (!node -> embedded) {
+		free(node);
+	}
+}
+
 /*
  * Return an empty queue.
  */
@@ -40,38 +54,92 @@ queue_new() {
 	return queue;
 }
 
-/*
- * Prepend a void* to a queue (both specifed as parameters).  Return
- * 0 (success) or -1 (failure).
- */
+void
+queue_link_init(q_node_t link, void* data) {
+	link -> data = data;
+	link -> prev = NULL;
+	link -> next = NULL;
+	link -> embedded = 1;
+}
+
 int
-queue_prepend(queue_t queue, void* item) {
-	q_node_t node;
-    if(NULL == queue) {
+queue_prepend_link(queue_t queue, q_node_t node) {
+    if(NULL == queue || NULL == node) {
 		return -1;
 	}
 	assert((queue->head != NULL && queue->tail != NULL) || (queue-> head == NULL && queue-> tail == NULL));
-    node = (q_node_t)malloc(sizeof(struct queue_node));
-	if (node == NULL) {
-		return -1;
-	}
 	node -> prev = NULL;
-	node -> data = item;
-	queue -> head = node;
-	queue -> q_length += 1;
+	node -> next = queue -> head;
 	// When the queue is empty
-	if(NULL == queue -> head && NULL == queue -> tail) {
-		node -> next = NULL;
+	if(NULL == queue -> head) {
 		queue -> tail = node;
 	} else {
-		node -> next = queue -> head;
 		queue -> head -> prev = node;
 	}
+	queue -> head = node;
+	queue -> q_length += 1;
 	assert(queue->head != NULL);
 	assert(queue->tail != NULL);
     return 0;
 }
 
+int
+queue_append_link(queue_t queue, q_node_t node) {
+	if( NULL == queue || NULL == node) {
+		return -1;
+	}
+	node -> prev = queue -> tail;
+	node -> next = NULL;
+	if( NULL == queue -> head && NULL == queue -> tail) { // Empty Queue
+		queue -> head = node;
+	} else { // Non Empty Queue
+		queue -> tail -> next = node;
+	}
+	queue -> tail = node;
+	queue -> q_length += 1;
+	assert(queue->head != NULL);
+	assert(queue->tail != NULL);
+	return 0;
+}
+
+int
+queue_unlink(queue_t queue, q_node_t node) {
+	if( NULL == queue || NULL == node || queue -> q_length == 0) {
+		return -1;
+	}
+	if( NULL == node -> prev) {
+		queue -> head = node -> next;
+	} else {
+		node -> prev -> next = node -> next;
+	}
+	if( NULL == node -> next) {
+		queue -> tail = node -> prev;
+	} else {
+		node -> next -> prev = node -> prev;
+	}
+	node -> prev = NULL;
+	node -> next = NULL;
+	queue -> q_length -= 1;
+	return 0;
+}
+
+/*
+ * Prepend a void* to a queue (both specifed as parameters).  Return
+ * 0 (success) or -1 (failure).
+ */
+int
+queue_prepend(queue_t queue, void* item) {
+	q_node_t node;
+    if(NULL == queue) {
+		return -1;
+	}
+    node = node_new(item);
+	if (node == NULL) {
+		return -1;
+	}
+	return queue_prepend_link(queue, node);
+}
+
 /*
  * Append a void* to a queue (both specifed as parameters). Return
  * 0 (success) or -1 (failure).
@@ -82,28 +150,11 @@ queue_append(queue_t queue, void* item) {
 	if( NULL == queue) {
 		return -1;
 	}
-	node = (q_node_t)malloc(sizeof(struct queue_node));
+	node = node_new(item);
 	if (NULL == node) {
 		return -1;
 	}
-	if( NULL == queue -> head && NULL == queue -> tail) { // Empty Queue
-		node -> data = item;
-		node -> prev = NULL;
-		node -> next = NULL;
-		queue -> head = node;
-		queue -> tail = node;
-        queue -> q_length += 1;
-	} else { // Non Empty Queue
-		node -> data = item;
-		node -> prev = queue -> tail;
-		node -> next = NULL;
-		queue -> tail -> next = node;
-		queue -> tail = node;
-        queue -> q_length += 1;
-	}
-	assert(queue->head != NULL);
-	assert(queue->tail != NULL);
-	return 0;
+	return queue_append_link(queue, node);
 }
 
 /*
@@ -132,7 +183,7 @@ queue_dequeue(queue_t queue, void** item) {
 		queue->head->prev = NULL;
 	}
 	queue->q_length -= 1;
-	free(temp);
+	node_release(temp);
 	assert((queue->head != NULL && queue->tail != NULL) ||
 		(queue->head == NULL && queue->tail == NULL));
 	
@@ -179,7 +230,7 @@ queue_free(queue_t queue) {
 	while(current != NULL) {
 		temp = current;
 		current = current->next;
-		free(temp);
+		node_release(temp);
 	}
 	free(queue);
 	return 0;
@@ -202,35 +253,30 @@ queue_length(queue_t queue) {
  */
 int
 queue_delete(queue_t queue, void** item) {
-	q_node_t q_node_ptr = queue -> head;
+	q_node_t q_node_ptr;
 	if( NULL == queue) {
-		return 0;
-	} else if(queue -> head -> data == *item ) { //delete at head
-        //head is not the only node
-        if(NULL != q_node_ptr -> next) {
-            q_node_ptr -> next -> prev = NULL;
-            queue -> head = q_node_ptr -> next;
-        } else {
-            //only node in queue is deleted, return empty queue.
-        }
-		free(q_node_ptr);
-		return 0;
-	} else if(queue -> tail -> data == *item ) { //delete at tail
-		q_node_ptr -> prev -> next = NULL;
+		return -1;
+	}
+	for (q_node_ptr = queue -> head; q_node_ptr != NULL; q_node_ptr = q_node_ptr -> next) {
+		if (q_node_ptr -> data == *item) {
+			break;
+		}
+	}
+	if (q_node_ptr == NULL) {
+		return -1; //item not found in queue, so send fail
+	}
+	if (q_node_ptr -> prev == NULL) { //delete at head
+		queue -> head = q_node_ptr -> next;
+	} else {
+		q_node_ptr -> prev -> next = q_node_ptr -> next;
+	}
+	if (q_node_ptr -> next == NULL) { //delete at tail
 		queue -> tail = q_node_ptr -> prev;
-		free(q_node_ptr);
-		return 0;
 	} else {
-		while( q_node_ptr -> data != *item) {
-			if(q_node_ptr -> next == NULL) {
-				return -1; //item not found in queue, so send fail
-			}
-			q_node_ptr = q_node_ptr -> next;
-		}
+		q_node_ptr -> next -> prev = q_node_ptr -> prev;
 	}
-	q_node_ptr -> prev -> next = q_node_ptr -> next;
-	q_node_ptr -> next -> prev = q_node_ptr -> prev;
-	free(q_node_ptr);
+	queue -> q_length -= 1;
+	node_release(q_node_ptr);
 	return 0;
 }
 
@@ -248,12 +294,11 @@ queue_insert_sorted(queue_t queue, PFany compare, void *item) {
 	if (queue == NULL || compare == NULL) {
 		return -1;
 	}
-	new_node = (q_node_t)malloc(sizeof(struct queue_node));
+	new_node = node_new(item);
 	if (new_node == NULL) {
 		fprintf(stderr, "No memory!!!");
 		return -1;
 	}
-	new_node->data = item;
 	new_node->next = NULL;
 	new_node->prev = NULL;
 	// empty queue
@@ -325,7 +370,7 @@ queue_delete_by_predicate(queue_t queue, PFany predicate, void* arg2) {
 			}
 			current = current->next;
             queue_item = temp->data;
-			free(temp);
+			node_release(temp);
 			queue->q_length--;
 		} else {
 			current = current->next;
@@ -17,6 +17,20 @@ typedef int (*PFany)(void*, void*);
  */
 typedef struct queue* queue_t;
 
+/*
+ * q_node_t is a pointer to a queue node. Nodes are normally allocated by the
+ * queue, but a client can embed a struct queue_node in its own structure and
+ * link it with queue_append_link/queue_prepend_link so that enqueueing and
+ * dequeueing never touch the allocator. An embedded node can be on at most one
+ * queue at a time and is never freed by the queue.
+ */
+typedef struct queue_node {
+	void* data;
+	struct queue_node* prev;
+	struct queue_node* next;
+	int embedded;
+} *q_node_t;
+
 /*
  * Return an empty queue. On error should return NULL.
  */
@@ -34,6 +48,24 @@ extern int queue_prepend(queue_t, void*);
  */
 extern int queue_append(queue_t, void*);
 
+/*
+ * Initialize an embedded node that carries data.
+ */
+extern void queue_link_init(q_node_t link, void* data);
+
+/*
+ * Prepend or append an embedded node to a queue without allocating. Return
+ * 0 (success) or -1 (failure).
+ */
+extern int queue_prepend_link(queue_t, q_node_t);
+extern int queue_append_link(queue_t, q_node_t);
+
+/*
+ * Unlink an embedded node from the queue it is on in O(1). The caller must
+ * know the node is on this queue. Return 0 (success) or -1 (failure).
+ */
+extern int queue_unlink(queue_t, q_node_t);
+
 /*
  * Dequeue and return the first void* from the queue. Return 0
  * (success) and first item if queue is nonempty, or -1 (failure) and
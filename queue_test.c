@@ -42,6 +42,61 @@ test_prepend(void) {
 	queue_free(queue);
 }
 
+void
+test_append_link(void) {
+	int x = 1;
+	int y = 2;
+	struct queue_node x_link, y_link;
+	void *out;
+	queue_t queue = queue_new();
+	queue_link_init(&x_link, &x);
+	queue_link_init(&y_link, &y);
+	queue_append_link(queue, &x_link);
+	queue_prepend_link(queue, &y_link);
+	assert(queue_length(queue) == 2);
+	queue_dequeue(queue, &out);
+	assert(*(int*)out == 2);
+	// a dequeued link can be reused on another queue right away
+	queue_append_link(queue, &y_link);
+	queue_append(queue, &x);
+	queue_dequeue(queue, &out);
+	assert(*(int*)out == 1);
+	queue_dequeue(queue, &out);
+	assert(*(int*)out == 2);
+	queue_dequeue(queue, &out);
+	assert(*(int*)out == 1);
+	queue_dequeue(queue, &out);
+	assert(out == NULL);
+	queue_free(queue);
+}
+
+void
+test_unlink(void) {
+	int x = 1;
+	int y = 2;
+	int z = 3;
+	struct queue_node x_link, y_link, z_link;
+	void *out;
+	queue_t queue = queue_new();
+	queue_link_init(&x_link, &x);
+	queue_link_init(&y_link, &y);
+	queue_link_init(&z_link, &z);
+	queue_append_link(queue, &x_link);
+	queue_append_link(queue, &y_link);
+	queue_append_link(queue, &z_link);
+	queue_unlink(queue, &y_link);
+	assert(queue_length(queue) == 2);
+	queue_unlink(queue, &z_link);
+	queue_append_link(queue, &y_link);
+	queue_unlink(queue, &x_link);
+	queue_dequeue(queue, &out);
+	assert(*(int*)out == 2);
+	assert(queue_length(queue) == 0);
+	queue_dequeue(queue, &out);
+	assert(out == NULL);
+	queue_free(queue);
+}
+
 void
 test_length(void) {
 	assert(1);
@@ -99,6 +154,8 @@ main(void) {
 	fprintf(stdout, "Testing queue...\n");
 	test_append();
 	test_prepend();
+	test_append_link();
+	test_unlink();
 	test_length();
 	test_delete();
 	test_iterate();
@@ -1,24 +1,167 @@
-    #include <stdlib.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 
 #include "scheduler.h"
 #include "minithread.h"
 #include "multilevel_queue.h"
 #include "interrupts.h"
 
-#define SCHEDULER_LEVELS 4
 #define TICKS_LEVEL_0 80
 #define TICKS_LEVEL_1 40
 #define TICKS_LEVEL_2 24
 #define TICKS_LEVEL_3 16
 
+#define ROUND_ROBIN_QUANTUM 2
+#define LOTTERY_QUANTUM 1
+
+/*
+ * A scheduling policy decides where a runnable thread is queued, which
+ * queued thread runs next, and how long the running thread's quantum is.
+ * The entry points in scheduler.h do the bookkeeping shared by all policies
+ * and defer to the selected one.
+ */
+typedef struct scheduler_policy_ops {
+	int (*level_of)(minithread_t thread);
+	int (*next_level)();
+	void (*advance)();
+	int (*quantum)();
+} *scheduler_policy_ops_t;
+
 multilevel_queue_t queue;
+multilevel_queue_t realtime_queue; // fixed-priority band, drained before queue
+int realtime_size;
 int size;
 int current_level;
 int thread_ticks_remaining; // before a scheduling change
 int level_ticks_remaining; // before switching levels
 minithread_t idle;
+enum scheduler_policy policy = SCHEDULER_MLFQ;
+scheduler_policy_ops_t ops;
+
+#ifdef SCHEDULER_STATS
+typedef struct scheduler_trace_event {
+	long tick;
+	int from_id;
+	int to_id;
+	int level;
+} scheduler_trace_event;
+
+struct scheduler_stats stats;
+scheduler_trace_event trace[SCHEDULER_TRACE_SIZE];
+int trace_next; // slot the next event is written to
+int trace_count;
+#endif
+
+/*
+ * Multilevel feedback: threads queue at their priority, each level gets a fixed
+ * share of ticks in turn, and the quantum doubles with every level.
+ */
+int
+mlfq_level_of(minithread_t thread) {
+	return minithread_priority(thread);
+}
+
+int
+mlfq_next_level() {
+	return current_level;
+}
+
+void
+mlfq_advance() {
+	level_ticks_remaining--;
+	if (level_ticks_remaining < 0) {
+		current_level = (current_level + 1) % SCHEDULER_LEVELS;
+		switch (current_level) {
+		case 0: 
+			level_ticks_remaining = TICKS_LEVEL_0;
+			break;
+		case 1: 
+			level_ticks_remaining = TICKS_LEVEL_1;
+			break;
+		case 2: 
+			level_ticks_remaining = TICKS_LEVEL_2;
+			break;
+		case 3: 
+			level_ticks_remaining = TICKS_LEVEL_3;
+			break;
+		}
+	}
+}
+
+int
+mlfq_quantum() {
+	return 1 << current_level;
+}
+
+/*
+ * Round robin: one FIFO and a fixed quantum, priorities are ignored.
+ */
+int
+round_robin_level_of(minithread_t thread) {
+	return 0;
+}
+
+int
+round_robin_next_level() {
+	return 0;
+}
+
+void
+round_robin_advance() {
+}
+
+int
+round_robin_quantum() {
+	return ROUND_ROBIN_QUANTUM;
+}
+
+/*
+ * Lottery: threads queue at their priority and every thread of a level holds
+ * that level's number of tickets, halving with each level. A draw picks the
+ * winning level in proportion to the tickets queued there, and the level's
+ * head thread runs, so threads of one level still take turns.
+ */
+int lottery_tickets[SCHEDULER_LEVELS] = {8, 4, 2, 1};
+
+int
+lottery_next_level() {
+	int level, total, draw;
+
+	total = 0;
+	for (level = 0; level < SCHEDULER_LEVELS; level++) {
+		total += multilevel_queue_length_at(queue, level) * lottery_tickets[level];
+	}
+	draw = rand() % total;
+	for (level = 0; level < SCHEDULER_LEVELS; level++) {
+		draw -= multilevel_queue_length_at(queue, level) * lottery_tickets[level];
+		if (draw < 0) {
+			break;
+		}
+	}
+	return level;
+}
+
+int
+lottery_quantum() {
+	return LOTTERY_QUANTUM;
+}
+
+struct scheduler_policy_ops policies[] = {
+	{ mlfq_level_of, mlfq_next_level, mlfq_advance, mlfq_quantum },
+	{ round_robin_level_of, round_robin_next_level, round_robin_advance, round_robin_quantum },
+	{ mlfq_level_of, lottery_next_level, round_robin_advance, lottery_quantum }
+};
+
+int
+scheduler_select_policy(enum scheduler_policy new_policy) {
+	if (new_policy < SCHEDULER_MLFQ || new_policy > SCHEDULER_LOTTERY) {
+		return -1;
+	}
+	policy = new_policy;
+	return 0;
+}
 
 int
 scheduler_initialize() {
@@ -27,10 +170,20 @@ scheduler_initialize() {
 		fprintf(stderr, "Out of memory in scheduler_new");
 		return -1;
 	}
+	realtime_queue = multilevel_queue_new(MINITHREAD_PRIORITIES);
+	if (realtime_queue == NULL) {
+		fprintf(stderr, "Out of memory in scheduler_new");
+		return -1;
+	}
+	ops = &policies[policy];
+	realtime_size = 0;
 	size = 0;
 	current_level = 0;
 	thread_ticks_remaining = 1;
 	level_ticks_remaining = TICKS_LEVEL_0;
+#ifdef SCHEDULER_STATS
+	scheduler_reset_stats();
+#endif
 	return 0;
 }
 
@@ -40,18 +193,32 @@ scheduler_set_idle(minithread_t idle_thread) {
 }
 
 /* Ignores the idle thread.
+ * Real-time threads are queued at their fixed priority outside the policy.
  */
 int
 scheduler_schedule(minithread_t thread) {
 	int level, success;
 
-	if (minithread_get_status(thread) == OK) {
-		level = minithread_priority(thread);
-		success = multilevel_queue_enqueue(queue, level, thread);
+	if (minithread_get_status(thread) == OK && minithread_policy(thread) == THREAD_REALTIME) {
+		success = multilevel_queue_enqueue_link(realtime_queue, minithread_priority(thread),
+				minithread_queue_link(thread));
 		if (success == -1) {
 			return -1;
 		}
+		realtime_size += 1;
 		size += 1;
+	} else if (minithread_get_status(thread) == OK) {
+		level = ops->level_of(thread);
+		success = multilevel_queue_enqueue_link(queue, level, minithread_queue_link(thread));
+		if (success == -1) {
+			return -1;
+		}
+		size += 1;
+#ifdef SCHEDULER_STATS
+		if (multilevel_queue_length_at(queue, level) > stats.max_queue_depth[level]) {
+			stats.max_queue_depth[level] = multilevel_queue_length_at(queue, level);
+		}
+#endif
 	}
 	return 0;
 }
@@ -61,8 +228,16 @@ scheduler_next_thread() {
 	void* out = NULL;
     if (size == 0) {
 		out = idle;
+	} else if (realtime_size > 0) {
+		// dequeueing from level 0 takes the highest real-time priority first
+        multilevel_queue_dequeue(realtime_queue, 0, &out);
+        if(out == NULL) {
+            return NULL;
+        }
+        realtime_size -= 1;
+        size -= 1;
 	} else {
-        multilevel_queue_dequeue(queue, current_level, &out);
+        multilevel_queue_dequeue(queue, ops->next_level(), &out);
         if(out == NULL) {
             return NULL;
         }
@@ -83,26 +258,98 @@ scheduler_quota_expired() {
 
 void
 scheduler_advance() {
-	level_ticks_remaining--;
-	if (level_ticks_remaining < 0) {
-		current_level = (current_level + 1) % SCHEDULER_LEVELS;
-		switch (current_level) {
-		case 0: 
-			level_ticks_remaining = TICKS_LEVEL_0;
-			break;
-		case 1: 
-			level_ticks_remaining = TICKS_LEVEL_1;
-			break;
-		case 2: 
-			level_ticks_remaining = TICKS_LEVEL_2;
-			break;
-		case 3: 
-			level_ticks_remaining = TICKS_LEVEL_3;
-			break;
-		}
+#ifdef SCHEDULER_STATS
+	minithread_t running = minithread_self();
+
+	if (running == idle) {
+		stats.idle_ticks++;
+	} else if (minithread_policy(running) == THREAD_REALTIME) {
+		// real-time priorities are not feedback levels
+		stats.realtime_ticks++;
+	} else {
+		stats.level_ticks[minithread_priority(running)]++;
 	}
+#endif
+	ops->advance();
 	thread_ticks_remaining--;
 	if (thread_ticks_remaining < 0) {
-		thread_ticks_remaining = 1 << current_level;
+		thread_ticks_remaining = ops->quantum();
+	}
+}
+
+#ifdef SCHEDULER_STATS
+void
+scheduler_get_stats(scheduler_stats_t out) {
+	interrupt_level_t level;
+
+	level = set_interrupt_level(DISABLED);
+	*out = stats;
+	set_interrupt_level(level);
+}
+
+void
+scheduler_reset_stats() {
+	interrupt_level_t level;
+
+	level = set_interrupt_level(DISABLED);
+	memset(&stats, 0, sizeof(struct scheduler_stats));
+	trace_next = 0;
+	trace_count = 0;
+	set_interrupt_level(level);
+}
+
+/* Called from minithread_yield with interrupts disabled.
+ */
+void
+scheduler_record_switch(minithread_t from, minithread_t to) {
+	stats.context_switches++;
+	trace[trace_next].tick = ticks;
+	trace[trace_next].from_id = minithread_get_id(from);
+	trace[trace_next].to_id = minithread_get_id(to);
+	trace[trace_next].level = current_level;
+	trace_next = (trace_next + 1) % SCHEDULER_TRACE_SIZE;
+	if (trace_count < SCHEDULER_TRACE_SIZE) {
+		trace_count++;
+	}
+}
+
+void
+scheduler_record_priority_change(int old_priority, int new_priority) {
+	if (new_priority > old_priority) {
+		stats.demotions++;
+	} else if (new_priority < old_priority) {
+		stats.promotions++;
+	}
+}
+
+void
+scheduler_record_idle_tick() {
+	stats.idle_ticks++;
+}
+
+int
+scheduler_trace_dump(char* filename) {
+	FILE* file;
+	scheduler_trace_event copy[SCHEDULER_TRACE_SIZE];
+	int i, count, first;
+	interrupt_level_t level;
+
+	// snapshot the ring so file I/O happens with interrupts enabled
+	level = set_interrupt_level(DISABLED);
+	memcpy(copy, trace, sizeof(trace));
+	count = trace_count;
+	first = (trace_next - trace_count + SCHEDULER_TRACE_SIZE) % SCHEDULER_TRACE_SIZE;
+	set_interrupt_level(level);
+
+	file = fopen(filename, "w");
+	if (file == NULL) {
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		scheduler_trace_event* event = &copy[(first + i) % SCHEDULER_TRACE_SIZE];
+		fprintf(file, "%ld %d %d %d\n", event->tick, event->from_id, event->to_id, event->level);
 	}
+	fclose(file);
+	return count;
 }
+#endif
@@ -3,8 +3,32 @@
 
 #include "minithread.h"
 
+#define SCHEDULER_LEVELS 4
+
 typedef struct scheduler *scheduler_t;
 
+/*
+ * Scheduling policies the scheduler can run:
+ *  SCHEDULER_MLFQ        multilevel feedback queue, levels share time 80/40/24/16
+ *                        and a level's quantum is 1 << level ticks (the default)
+ *  SCHEDULER_ROUND_ROBIN one queue, fixed quantum, thread priorities ignored
+ *  SCHEDULER_LOTTERY     threads hold tickets by priority level (8/4/2/1) and
+ *                        each scheduling decision is a weighted draw
+ * The policy only orders THREAD_FEEDBACK threads. THREAD_REALTIME threads are
+ * kept in a separate fixed-priority band that is always drained first.
+ */
+enum scheduler_policy {
+	SCHEDULER_MLFQ,
+	SCHEDULER_ROUND_ROBIN,
+	SCHEDULER_LOTTERY
+};
+
+/*
+ * Choose the policy scheduler_initialize sets up. Must be called before
+ * minithread_system_initialize. Return 0 on success, -1 on failure.
+ */
+int scheduler_select_policy(enum scheduler_policy policy);
+
 int scheduler_initialize();
 
 void scheduler_set_idle(minithread_t idle);
@@ -35,4 +59,62 @@ int scheduler_quota_expired();
  */
 void scheduler_advance();
 
+/*
+ * Scheduler statistics and switch tracing. Compiled in only when
+ * SCHEDULER_STATS is defined; otherwise the recording hooks expand to nothing.
+ */
+#ifdef SCHEDULER_STATS
+
+/* number of switch events kept by the trace ring buffer */
+#define SCHEDULER_TRACE_SIZE 1024
+
+typedef struct scheduler_stats {
+	long level_ticks[SCHEDULER_LEVELS]; /* ticks consumed by feedback threads of each level */
+	long realtime_ticks;                /* ticks consumed by THREAD_REALTIME threads */
+	long idle_ticks;                    /* ticks spent in the idle thread */
+	long context_switches;
+	long promotions;
+	long demotions;
+	int max_queue_depth[SCHEDULER_LEVELS];
+} *scheduler_stats_t;
+
+/*
+ * Copy the counters gathered since initialization or the last reset into stats.
+ */
+void scheduler_get_stats(scheduler_stats_t stats);
+
+/*
+ * Zero the counters and empty the trace.
+ */
+void scheduler_reset_stats();
+
+/*
+ * Record a switch from one thread to another in the counters and the trace.
+ */
+void scheduler_record_switch(minithread_t from, minithread_t to);
+
+/*
+ * Record a thread moving from one priority level to another.
+ */
+void scheduler_record_priority_change(int old_priority, int new_priority);
+
+/*
+ * Record a tick spent idle that did not go through scheduler_advance.
+ */
+void scheduler_record_idle_tick();
+
+/*
+ * Write the trace, oldest event first, as "tick from_id to_id level" lines,
+ * where level is the scheduler level being served at the switch. Return the number of events written or -1 on failure.
+ */
+int scheduler_trace_dump(char* filename);
+
+#else
+
+#define scheduler_record_switch(from, to)
+#define scheduler_record_priority_change(old_priority, new_priority)
+#define scheduler_record_idle_tick()
+
+#endif
+
 #endif __SCHEDULER_H_
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+ * Semaphore microbenchmark.
+ *
+ * Times uncontended P/V pairs on one semaphore, then a ping-pong between two
+ * threads that has to block and wake on every item. Build once as is and once
+ * with -DSEMAPHORE_NO_FASTPATH for synch.c to compare the compare-and-swap
+ * fast path against the TAS lock and interrupt masking path.
+ *
+ * Change PAIRS and ROUNDS to vary the length of each run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "minithread.h"
+#include "synch.h"
+
+#define PAIRS 1000000
+#define ROUNDS 10000
+
+semaphore_t uncontended;
+semaphore_t ping;
+semaphore_t pong;
+semaphore_t done;
+
+static double
+nanoseconds_per(clock_t start, clock_t end, int count) {
+  return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / count;
+}
+
+int ponger(int* arg) {
+  int i;
+
+  for (i = 0; i < *arg; i++) {
+    semaphore_P(ping);
+    semaphore_V(pong);
+  }
+  semaphore_V(done);
+
+  return 0;
+}
+
+int bench(int* arg) {
+  clock_t start, end;
+  int rounds = ROUNDS;
+  int i;
+
+  start = clock();
+  for (i = 0; i < PAIRS; i++) {
+    semaphore_P(uncontended);
+    semaphore_V(uncontended);
+  }
+  end = clock();
+  printf("uncontended P/V pair: %.1f ns\n", nanoseconds_per(start, end, PAIRS));
+
+  minithread_fork(ponger, &rounds);
+  start = clock();
+  for (i = 0; i < rounds; i++) {
+    semaphore_V(ping);
+    semaphore_P(pong);
+  }
+  semaphore_P(done);
+  end = clock();
+  printf("ping-pong round trip: %.1f ns\n", nanoseconds_per(start, end, rounds));
+
+  return 0;
+}
+
+void
+main(void) {
+  uncontended = semaphore_create();
+  semaphore_initialize(uncontended, 1);
+  ping = semaphore_create();
+  semaphore_initialize(ping, 0);
+  pong = semaphore_create();
+  semaphore_initialize(pong, 0);
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+
+  minithread_system_initialize(bench, NULL);
+}
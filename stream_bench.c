@@ -0,0 +1,164 @@
+/*
+ * Concurrent stream benchmark.
+ *
+ * STREAMS connections between two machines each push BUFFER_SIZE bytes at
+ * once, so that they compete for the network and for any node forwarding
+ * between the two. When every stream is done the receiving side prints the
+ * goodput of each, the aggregate goodput and Jain's fairness index
+ * (1 when all streams got the same share, 1/STREAMS when one got it all).
+ *
+ *    usage: stream_bench               run the sending side
+ *           stream_bench <hostname>    run the receiving side against hostname
+ *           stream_bench -forward      only forward packets for the others
+ *
+ * To measure through a forwarding node, run the two sides on hosts that
+ * can only reach each other through a third one running with -forward.
+ *
+ * Change STREAMS and BUFFER_SIZE to vary the load.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interrupts.h"
+#include "minithread.h"
+#include "minisocket.h"
+#include "synch.h"
+
+#define STREAMS 8
+#define BUFFER_SIZE 100000
+#define FIRST_PORT 80
+
+char* hostname;
+int stream_id[STREAMS];
+long elapsed[STREAMS]; /* ticks from connecting to the last byte received */
+semaphore_t done;
+
+int sender(int* arg) {
+  char buffer[BUFFER_SIZE];
+  minisocket_t socket;
+  minisocket_error error;
+  minisocket_stats_t stats;
+  int i, sent, bytes;
+
+  socket = minisocket_server_create(FIRST_PORT + *arg, &error);
+  if (socket == NULL) {
+    printf("stream %d: can't create the server, error %d\n", *arg, error);
+    return 0;
+  }
+  for (i = 0; i < BUFFER_SIZE; i++) {
+    buffer[i] = i % 128;
+  }
+  for (sent = 0; sent < BUFFER_SIZE; sent += bytes) {
+    bytes = minisocket_send(socket, buffer + sent, BUFFER_SIZE - sent, &error);
+    if (bytes == -1) {
+      printf("stream %d: send error %d\n", *arg, error);
+      return 0;
+    }
+  }
+  minisocket_get_stats(socket, &stats);
+  printf("stream %d: sent %d segments, %d retransmitted, srtt %d ms, cwnd %d\n",
+         *arg, stats.segments_sent, stats.retransmissions, stats.srtt, stats.cwnd);
+  minisocket_close(socket);
+  return 0;
+}
+
+int receiver(int* arg) {
+  char buffer[BUFFER_SIZE];
+  network_address_t address;
+  minisocket_t socket;
+  minisocket_error error;
+  long start;
+  int received, bytes;
+
+  network_translate_hostname(hostname, address);
+  socket = minisocket_client_create(address, FIRST_PORT + *arg, &error);
+  if (socket == NULL) {
+    printf("stream %d: can't connect, error %d\n", *arg, error);
+    semaphore_V(done);
+    return 0;
+  }
+  start = ticks;
+  for (received = 0; received < BUFFER_SIZE; received += bytes) {
+    bytes = minisocket_receive(socket, buffer + received, BUFFER_SIZE - received, &error);
+    if (bytes < 0) {
+      printf("stream %d: receive error %d\n", *arg, error);
+      break;
+    }
+  }
+  elapsed[*arg] = received == BUFFER_SIZE ? ticks - start : -1;
+  minisocket_close(socket);
+  semaphore_V(done);
+  return 0;
+}
+
+int send_streams(int* arg) {
+  int i;
+
+  for (i = 0; i < STREAMS; i++) {
+    minithread_fork(sender, &stream_id[i]);
+  }
+  return 0;
+}
+
+int receive_streams(int* arg) {
+  double goodput, total, sum, sum_squares;
+  int i, finished;
+
+  for (i = 0; i < STREAMS; i++) {
+    minithread_fork(receiver, &stream_id[i]);
+  }
+  for (i = 0; i < STREAMS; i++) {
+    semaphore_P(done);
+  }
+
+  total = 0;
+  sum_squares = 0;
+  finished = 0;
+  for (i = 0; i < STREAMS; i++) {
+    if (elapsed[i] < 0) {
+      printf("stream %d: failed\n", i);
+      continue;
+    }
+    // a stream finishing within one tick is counted as taking one
+    goodput = BUFFER_SIZE / ((elapsed[i] > 0 ? elapsed[i] : 1) * (double)(PERIOD / MILLISECOND) / 1000);
+    printf("stream %d: %.0f bytes/s\n", i, goodput);
+    total += goodput;
+    sum_squares += goodput * goodput;
+    finished++;
+  }
+  sum = total;
+  printf("aggregate goodput: %.0f bytes/s over %d streams\n", total, finished);
+  if (finished > 0 && sum_squares > 0) {
+    printf("fairness index: %.3f\n", sum * sum / (finished * sum_squares));
+  }
+  return 0;
+}
+
+int forward(int* arg) {
+  semaphore_t forever;
+
+  // the network handler forwards packets, this thread only keeps us alive
+  forever = semaphore_create();
+  semaphore_initialize(forever, 0);
+  semaphore_P(forever);
+  return 0;
+}
+
+main(int argc, char** argv) {
+  int i;
+
+  for (i = 0; i < STREAMS; i++) {
+    stream_id[i] = i;
+  }
+  done = semaphore_create();
+  semaphore_initialize(done, 0);
+
+  if (argc > 1 && strcmp(argv[1], "-forward") == 0) {
+    minithread_system_initialize(forward, NULL);
+  } else if (argc > 1) {
+    hostname = argv[1];
+    minithread_system_initialize(receive_streams, NULL);
+  } else {
+    minithread_system_initialize(send_streams, NULL);
+  }
+}
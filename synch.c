@@ -7,9 +7,17 @@
 #include "queue.h"
 #include "minithread.h"
 #include "interrupts.h"
+#include "waitqueue.h"
 
 /*
  * Semaphores.
+ *
+ * cnt is only ever negative while threads are queued on the semaphore, and
+ * it only goes negative with the TAS lock held and interrupts disabled. So a
+ * P that finds cnt positive, or a V that finds it non-negative, has nobody to
+ * block or wake and just moves cnt with a compare-and-swap. Everything else
+ * takes the slow path. Define SEMAPHORE_NO_FASTPATH to always take the slow
+ * path, e.g. to compare against it with semaphore_bench.c.
  */
 struct semaphore {
     int cnt;
@@ -65,15 +73,27 @@ semaphore_initialize(semaphore_t sem, int cnt) {
 void
 semaphore_P(semaphore_t sem) {
     interrupt_level_t level;
-    
+#ifndef SEMAPHORE_NO_FASTPATH
+    int cnt;
+
+    cnt = sem -> cnt;
+    while(cnt > 0) {
+        if(compare_and_swap(&(sem -> cnt), cnt, cnt - 1) == cnt) {
+            return;
+        }
+        cnt = sem -> cnt;
+    }
+#endif
+
     while(1 == atomic_test_and_set(&(sem -> l)));
     level = set_interrupt_level(DISABLED);
     sem -> cnt -=1;
     
     // since the internal count is <0 put the thread to the sema_queue and put it to sleep.
+    // interrupts stay disabled until the thread has stopped, so a V cannot start it
+    // while its queue link is still in use
     if(sem -> cnt <0) {
-        queue_append(sem -> sema_queue, minithread_self());
-        set_interrupt_level(level);
+        queue_append_link(sem -> sema_queue, minithread_queue_link(minithread_self()));
         minithread_unlock_and_stop(&(sem -> l));
     } else {
         atomic_clear(&(sem -> l));
@@ -90,6 +110,18 @@ semaphore_V(semaphore_t sem) {
     void* item;
     minithread_t wake_thread;
     interrupt_level_t level;
+#ifndef SEMAPHORE_NO_FASTPATH
+    int cnt;
+
+    cnt = sem -> cnt;
+    while(cnt >= 0) {
+        if(compare_and_swap(&(sem -> cnt), cnt, cnt + 1) == cnt) {
+            return;
+        }
+        cnt = sem -> cnt;
+    }
+#endif
+
     while(1 == atomic_test_and_set(&(sem -> l)));
     level = set_interrupt_level(DISABLED);
     sem -> cnt += 1;
@@ -100,8 +132,432 @@ semaphore_V(semaphore_t sem) {
             fprintf(stdout, "dequeue error in semaphore_V\n");
         }
         wake_thread = (minithread_t) item;
+        // a timed waiter no longer needs its timeout
+        if(minithread_wait_node(wake_thread) -> key == sem) {
+            waitqueue_disarm_timeout(minithread_wait_node(wake_thread));
+            minithread_wait_node(wake_thread) -> key = NULL;
+        }
         minithread_start(wake_thread);
     }
     atomic_clear(&(sem -> l));
     set_interrupt_level(level);
 }
+
+/*
+ * semaphore_tryP(semaphore_t sem)
+ *	P on the semaphore only if that would not block.
+ */
+int
+semaphore_tryP(semaphore_t sem) {
+#ifndef SEMAPHORE_NO_FASTPATH
+    int cnt;
+
+    cnt = sem -> cnt;
+    while(cnt > 0) {
+        if(compare_and_swap(&(sem -> cnt), cnt, cnt - 1) == cnt) {
+            return 0;
+        }
+        cnt = sem -> cnt;
+    }
+    return -1;
+#else
+    interrupt_level_t level;
+    int result;
+
+    while(1 == atomic_test_and_set(&(sem -> l)));
+    level = set_interrupt_level(DISABLED);
+    result = -1;
+    if(sem -> cnt > 0) {
+        sem -> cnt -= 1;
+        result = 0;
+    }
+    atomic_clear(&(sem -> l));
+    set_interrupt_level(level);
+    return result;
+#endif
+}
+
+/*
+ * Timeout of a semaphore_P_timeout. It runs with interrupts disabled, which
+ * already excludes every P and V that could be looking at the semaphore: a
+ * thread holding the TAS lock with interrupts still enabled has not touched
+ * the semaphore yet.
+ */
+static void
+semaphore_expire(waitqueue_node_t node) {
+    semaphore_t sem = (semaphore_t) node -> key;
+
+    queue_unlink(sem -> sema_queue, minithread_queue_link(node -> thread));
+    sem -> cnt += 1;
+    node -> key = NULL;
+    node -> timed_out = 1;
+    minithread_start(node -> thread);
+}
+
+/*
+ * semaphore_P_timeout(semaphore_t sem, int timeout)
+ *	P on the semaphore, giving up after timeout milliseconds. The timeout
+ *	rides on the thread's wait node, so it costs one alarm slot.
+ */
+int
+semaphore_P_timeout(semaphore_t sem, int timeout) {
+    interrupt_level_t level;
+    waitqueue_node_t node;
+
+    if(timeout < 0) {
+        semaphore_P(sem);
+        return 0;
+    }
+    if(semaphore_tryP(sem) == 0) {
+        return 0;
+    }
+    if(timeout == 0) {
+        return -1;
+    }
+
+    while(1 == atomic_test_and_set(&(sem -> l)));
+    level = set_interrupt_level(DISABLED);
+    sem -> cnt -= 1;
+    if(sem -> cnt >= 0) {
+        atomic_clear(&(sem -> l));
+        set_interrupt_level(level);
+        return 0;
+    }
+    node = minithread_wait_node(minithread_self());
+    node -> key = sem;
+    node -> timed_out = 0;
+    if(waitqueue_arm_timeout(node, timeout, semaphore_expire) == -1) {
+        sem -> cnt += 1;
+        node -> key = NULL;
+        atomic_clear(&(sem -> l));
+        set_interrupt_level(level);
+        return -1;
+    }
+    queue_append_link(sem -> sema_queue, minithread_queue_link(minithread_self()));
+    minithread_unlock_and_stop(&(sem -> l));
+    set_interrupt_level(level);
+    return node -> timed_out ? -1 : 0;
+}
+
+/*
+ * Queue the calling thread on waiters and block it, releasing l.
+ * Must be called with l held and interrupts disabled.
+ */
+static void
+block_on(queue_t waiters, tas_lock_t* l) {
+    queue_append_link(waiters, minithread_queue_link(minithread_self()));
+    minithread_unlock_and_stop(l);
+}
+
+/*
+ * Start the first thread queued on waiters. Return it, or NULL if there
+ * was none. Must be called with interrupts disabled.
+ */
+static minithread_t
+wake_one(queue_t waiters) {
+    void* item;
+
+    if(queue_dequeue(waiters, &item) == -1) {
+        return NULL;
+    }
+    minithread_start((minithread_t) item);
+    return (minithread_t) item;
+}
+
+/*
+ * Mutexes.
+ */
+struct mutex {
+    minithread_t owner; // NULL while unlocked
+    queue_t waiters;
+    tas_lock_t l;
+};
+
+mutex_t
+mutex_create() {
+    mutex_t mutex = (mutex_t)malloc(sizeof(struct mutex));
+    if(NULL == mutex) {
+        fprintf(stderr, "NO MEMORY");
+        return NULL;
+    }
+    mutex -> waiters = queue_new();
+    if(NULL == mutex -> waiters) {
+        fprintf(stderr, "NO MEMORY");
+        free(mutex);
+        return NULL;
+    }
+    mutex -> owner = NULL;
+    atomic_clear(&(mutex -> l));
+    return mutex;
+}
+
+void
+mutex_destroy(mutex_t mutex) {
+    queue_free(mutex -> waiters);
+    free(mutex);
+}
+
+void
+mutex_lock(mutex_t mutex) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(mutex -> l)));
+    level = set_interrupt_level(DISABLED);
+    if(NULL == mutex -> owner) {
+        mutex -> owner = minithread_self();
+        atomic_clear(&(mutex -> l));
+    } else {
+        // mutex_unlock makes us the owner before starting us
+        block_on(mutex -> waiters, &(mutex -> l));
+    }
+    set_interrupt_level(level);
+}
+
+void
+mutex_unlock(mutex_t mutex) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(mutex -> l)));
+    level = set_interrupt_level(DISABLED);
+    assert(mutex -> owner == minithread_self());
+    mutex -> owner = wake_one(mutex -> waiters);
+    atomic_clear(&(mutex -> l));
+    set_interrupt_level(level);
+}
+
+/*
+ * Condition variables.
+ */
+struct condvar {
+    queue_t waiters;
+    tas_lock_t l;
+};
+
+condvar_t
+condvar_create() {
+    condvar_t cond = (condvar_t)malloc(sizeof(struct condvar));
+    if(NULL == cond) {
+        fprintf(stderr, "NO MEMORY");
+        return NULL;
+    }
+    cond -> waiters = queue_new();
+    if(NULL == cond -> waiters) {
+        fprintf(stderr, "NO MEMORY");
+        free(cond);
+        return NULL;
+    }
+    atomic_clear(&(cond -> l));
+    return cond;
+}
+
+void
+condvar_destroy(condvar_t cond) {
+    queue_free(cond -> waiters);
+    free(cond);
+}
+
+void
+condvar_wait(condvar_t cond, mutex_t mutex) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(cond -> l)));
+    level = set_interrupt_level(DISABLED);
+    // we are queued before the mutex is released, so no signal can be lost
+    queue_append_link(cond -> waiters, minithread_queue_link(minithread_self()));
+    if(NULL != mutex) {
+        mutex_unlock(mutex);
+    }
+    minithread_unlock_and_stop(&(cond -> l));
+    set_interrupt_level(level);
+    if(NULL != mutex) {
+        mutex_lock(mutex);
+    }
+}
+
+void
+condvar_signal(condvar_t cond) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(cond -> l)));
+    level = set_interrupt_level(DISABLED);
+    wake_one(cond -> waiters);
+    atomic_clear(&(cond -> l));
+    set_interrupt_level(level);
+}
+
+void
+condvar_broadcast(condvar_t cond) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(cond -> l)));
+    level = set_interrupt_level(DISABLED);
+    while(NULL != wake_one(cond -> waiters));
+    atomic_clear(&(cond -> l));
+    set_interrupt_level(level);
+}
+
+/*
+ * Reader-writer locks.
+ *
+ * Like the mutex, the lock is handed over on release: a woken reader has
+ * already been counted in and a woken writer already owns the lock.
+ */
+struct rwlock {
+    int readers; // readers holding the lock
+    int writing; // 1 while a writer holds the lock
+    queue_t read_waiters;
+    queue_t write_waiters;
+    tas_lock_t l;
+};
+
+rwlock_t
+rwlock_create() {
+    rwlock_t lock = (rwlock_t)malloc(sizeof(struct rwlock));
+    if(NULL == lock) {
+        fprintf(stderr, "NO MEMORY");
+        return NULL;
+    }
+    lock -> read_waiters = queue_new();
+    lock -> write_waiters = queue_new();
+    if(NULL == lock -> read_waiters || NULL == lock -> write_waiters) {
+        fprintf(stderr, "NO MEMORY");
+        queue_free(lock -> read_waiters);
+        queue_free(lock -> write_waiters);
+        free(lock);
+        return NULL;
+    }
+    lock -> readers = 0;
+    lock -> writing = 0;
+    atomic_clear(&(lock -> l));
+    return lock;
+}
+
+void
+rwlock_destroy(rwlock_t lock) {
+    queue_free(lock -> read_waiters);
+    queue_free(lock -> write_waiters);
+    free(lock);
+}
+
+void
+rwlock_read_lock(rwlock_t lock) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(lock -> l)));
+    level = set_interrupt_level(DISABLED);
+    if(lock -> writing || queue_length(lock -> write_waiters) > 0) {
+        block_on(lock -> read_waiters, &(lock -> l));
+    } else {
+        lock -> readers += 1;
+        atomic_clear(&(lock -> l));
+    }
+    set_interrupt_level(level);
+}
+
+void
+rwlock_read_unlock(rwlock_t lock) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(lock -> l)));
+    level = set_interrupt_level(DISABLED);
+    assert(lock -> readers > 0);
+    lock -> readers -= 1;
+    if(0 == lock -> readers && NULL != wake_one(lock -> write_waiters)) {
+        lock -> writing = 1;
+    }
+    atomic_clear(&(lock -> l));
+    set_interrupt_level(level);
+}
+
+void
+rwlock_write_lock(rwlock_t lock) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(lock -> l)));
+    level = set_interrupt_level(DISABLED);
+    if(lock -> writing || lock -> readers > 0) {
+        block_on(lock -> write_waiters, &(lock -> l));
+    } else {
+        lock -> writing = 1;
+        atomic_clear(&(lock -> l));
+    }
+    set_interrupt_level(level);
+}
+
+void
+rwlock_write_unlock(rwlock_t lock) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(lock -> l)));
+    level = set_interrupt_level(DISABLED);
+    assert(lock -> writing);
+    lock -> writing = 0;
+    // readers that queued behind this writer go first, then the next writer
+    while(NULL != wake_one(lock -> read_waiters)) {
+        lock -> readers += 1;
+    }
+    if(0 == lock -> readers && NULL != wake_one(lock -> write_waiters)) {
+        lock -> writing = 1;
+    }
+    atomic_clear(&(lock -> l));
+    set_interrupt_level(level);
+}
+
+/*
+ * Barriers.
+ */
+struct barrier {
+    int parties;
+    int arrived;
+    queue_t waiters;
+    tas_lock_t l;
+};
+
+barrier_t
+barrier_create(int parties) {
+    barrier_t barrier;
+
+    if(parties <= 0) {
+        return NULL;
+    }
+    barrier = (barrier_t)malloc(sizeof(struct barrier));
+    if(NULL == barrier) {
+        fprintf(stderr, "NO MEMORY");
+        return NULL;
+    }
+    barrier -> waiters = queue_new();
+    if(NULL == barrier -> waiters) {
+        fprintf(stderr, "NO MEMORY");
+        free(barrier);
+        return NULL;
+    }
+    barrier -> parties = parties;
+    barrier -> arrived = 0;
+    atomic_clear(&(barrier -> l));
+    return barrier;
+}
+
+void
+barrier_destroy(barrier_t barrier) {
+    queue_free(barrier -> waiters);
+    free(barrier);
+}
+
+int
+barrier_wait(barrier_t barrier) {
+    interrupt_level_t level;
+
+    while(1 == atomic_test_and_set(&(barrier -> l)));
+    level = set_interrupt_level(DISABLED);
+    barrier -> arrived += 1;
+    if(barrier -> arrived < barrier -> parties) {
+        block_on(barrier -> waiters, &(barrier -> l));
+        set_interrupt_level(level);
+        return 0;
+    }
+    barrier -> arrived = 0;
+    while(NULL != wake_one(barrier -> waiters));
+    atomic_clear(&(barrier -> l));
+    set_interrupt_level(level);
+    return 1;
+}
@@ -8,6 +8,10 @@
  */
 
 typedef struct semaphore *semaphore_t;
+typedef struct mutex *mutex_t;
+typedef struct condvar *condvar_t;
+typedef struct rwlock *rwlock_t;
+typedef struct barrier *barrier_t;
 
 
 /*
@@ -45,5 +49,137 @@ extern void semaphore_P(semaphore_t sem);
  */
 extern void semaphore_V(semaphore_t sem);
 
+/*
+ * semaphore_tryP(semaphore_t sem)
+ *	P on the semaphore only if that would not block. Return 0 if the
+ *	semaphore was decremented and -1 otherwise.
+ */
+extern int semaphore_tryP(semaphore_t sem);
+
+/*
+ * semaphore_P_timeout(semaphore_t sem, int timeout)
+ *	P on the semaphore, giving up after timeout milliseconds. A negative
+ *	timeout waits forever and a timeout of 0 never blocks. Return 0 if the
+ *	semaphore was decremented and -1 if the wait timed out.
+ */
+extern int semaphore_P_timeout(semaphore_t sem, int timeout);
+
+/*
+ * Mutexes.
+ *
+ * Unlocking a mutex that has waiters hands it straight to the first of
+ * them, so a thread that keeps relocking cannot barge ahead of one that is
+ * already queued.
+ */
+
+/*
+ * mutex_t mutex_create()
+ *	Allocate a new, unlocked mutex. Return NULL on failure.
+ */
+extern mutex_t mutex_create();
+
+/*
+ * mutex_destroy(mutex_t mutex)
+ *	Deallocate a mutex. Nobody may hold it or be waiting on it.
+ */
+extern void mutex_destroy(mutex_t mutex);
+
+/*
+ * mutex_lock(mutex_t mutex)
+ *	Acquire the mutex, blocking until it is handed over if it is held.
+ */
+extern void mutex_lock(mutex_t mutex);
+
+/*
+ * mutex_unlock(mutex_t mutex)
+ *	Release the mutex, or pass it to the longest waiting thread.
+ */
+extern void mutex_unlock(mutex_t mutex);
+
+/*
+ * Condition variables.
+ */
+
+/*
+ * condvar_t condvar_create()
+ *	Allocate a new condition variable. Return NULL on failure.
+ */
+extern condvar_t condvar_create();
+
+/*
+ * condvar_destroy(condvar_t cond)
+ *	Deallocate a condition variable. Nobody may be waiting on it.
+ */
+extern void condvar_destroy(condvar_t cond);
+
+/*
+ * condvar_wait(condvar_t cond, mutex_t mutex)
+ *	Atomically release mutex and block until signalled, then reacquire
+ *	mutex before returning. mutex may be NULL if the caller protects its
+ *	condition by disabling interrupts instead; interrupts must then be
+ *	disabled on entry and are disabled again on return.
+ */
+extern void condvar_wait(condvar_t cond, mutex_t mutex);
+
+/*
+ * condvar_signal(condvar_t cond)
+ *	Wake the longest waiting thread, if any.
+ */
+extern void condvar_signal(condvar_t cond);
+
+/*
+ * condvar_broadcast(condvar_t cond)
+ *	Wake every waiting thread at once.
+ */
+extern void condvar_broadcast(condvar_t cond);
+
+/*
+ * Reader-writer locks.
+ *
+ * A waiting writer holds off new readers. When a writer unlocks, every
+ * waiting reader is let in before the next writer, so neither side starves.
+ */
+
+/*
+ * rwlock_t rwlock_create()
+ *	Allocate a new, unlocked reader-writer lock. Return NULL on failure.
+ */
+extern rwlock_t rwlock_create();
+
+/*
+ * rwlock_destroy(rwlock_t lock)
+ *	Deallocate a reader-writer lock. Nobody may hold it or be waiting on it.
+ */
+extern void rwlock_destroy(rwlock_t lock);
+
+extern void rwlock_read_lock(rwlock_t lock);
+extern void rwlock_read_unlock(rwlock_t lock);
+extern void rwlock_write_lock(rwlock_t lock);
+extern void rwlock_write_unlock(rwlock_t lock);
+
+/*
+ * Barriers.
+ */
+
+/*
+ * barrier_t barrier_create(int parties)
+ *	Allocate a barrier that releases every parties'th arrival together.
+ *	Return NULL on failure.
+ */
+extern barrier_t barrier_create(int parties);
+
+/*
+ * barrier_destroy(barrier_t barrier)
+ *	Deallocate a barrier. Nobody may be waiting on it.
+ */
+extern void barrier_destroy(barrier_t barrier);
+
+/*
+ * barrier_wait(barrier_t barrier)
+ *	Block until parties threads have arrived. The barrier then resets for
+ *	the next round. Return 1 to the last thread to arrive and 0 to the rest.
+ */
+extern int barrier_wait(barrier_t barrier);
+
 
 #endif __SYNCH_H__
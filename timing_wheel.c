@@ -0,0 +1,279 @@
+/*
+ * Hierarchical timing wheel implementation.
+ *
+ * Insert and remove are O(1). Advancing one tick touches a single level 0
+ * slot, plus one slot of each higher level whose range has just been used up
+ * (every TIMING_WHEEL_SLOTS ticks for level 1 and so on), so the cost of a
+ * tick does not grow with the number of pending timers. Advancing over many
+ * ticks at once skips the ones where nothing is filed instead of turning
+ * through them.
+ */
+#include "timing_wheel.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+struct timing_wheel_list {
+	timing_wheel_entry_t head;
+	timing_wheel_entry_t tail;
+};
+
+struct timing_wheel {
+	long current; // next tick to process
+	int length;
+	struct timing_wheel_list expired;
+	struct timing_wheel_list levels[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS];
+};
+
+static void
+list_append(struct timing_wheel_list* list, timing_wheel_entry_t entry) {
+	entry->list = list;
+	entry->next = NULL;
+	entry->prev = list->tail;
+	if (list->tail == NULL) {
+		list->head = entry;
+	} else {
+		list->tail->next = entry;
+	}
+	list->tail = entry;
+}
+
+static void
+list_unlink(struct timing_wheel_list* list, timing_wheel_entry_t entry) {
+	if (entry->prev == NULL) {
+		list->head = entry->next;
+	} else {
+		entry->prev->next = entry->next;
+	}
+	if (entry->next == NULL) {
+		list->tail = entry->prev;
+	} else {
+		entry->next->prev = entry->prev;
+	}
+	entry->prev = NULL;
+	entry->next = NULL;
+	entry->list = NULL;
+}
+
+/*
+ * Link entry into the level and slot its distance from the current tick
+ * falls in.
+ */
+static void
+place(timing_wheel_t wheel, timing_wheel_entry_t entry) {
+	long delta, expires;
+	int level;
+
+	delta = entry->expires - wheel->current;
+	if (delta < 0) {
+		list_append(&wheel->expired, entry);
+		return;
+	}
+	expires = entry->expires;
+	for (level = 0; level < TIMING_WHEEL_LEVELS - 1; level++) {
+		if (delta < (1L << (TIMING_WHEEL_BITS * (level + 1)))) {
+			break;
+		}
+	}
+	// beyond the range of the wheel, park it as far out as the top level reaches
+	if (delta >= (1L << (TIMING_WHEEL_BITS * TIMING_WHEEL_LEVELS))) {
+		expires = wheel->current + (1L << (TIMING_WHEEL_BITS * TIMING_WHEEL_LEVELS)) - 1;
+	}
+	list_append(&wheel->levels[level][(expires >> (TIMING_WHEEL_BITS * level)) & TIMING_WHEEL_MASK], entry);
+}
+
+/*
+ * Re-place every entry of a higher level slot now that the wheel has reached
+ * its range. Returns the slot index so the caller knows whether the next
+ * level up has wrapped as well.
+ */
+static int
+cascade(timing_wheel_t wheel, int level) {
+	int index;
+	timing_wheel_entry_t entry, next;
+
+	index = (wheel->current >> (TIMING_WHEEL_BITS * level)) & TIMING_WHEEL_MASK;
+	entry = wheel->levels[level][index].head;
+	wheel->levels[level][index].head = NULL;
+	wheel->levels[level][index].tail = NULL;
+	while (entry != NULL) {
+		next = entry->next;
+		place(wheel, entry);
+		entry = next;
+	}
+	return index;
+}
+
+/*
+ * Return the first tick at or after the current one at which a level 0 entry
+ * expires or a non-empty higher level slot is cascaded, -1 if there is none.
+ * The expired list is not considered.
+ */
+static long
+next_event(timing_wheel_t wheel) {
+	long earliest, base, tick;
+	int level, i, first;
+
+	earliest = -1;
+	for (i = 0; i < TIMING_WHEEL_SLOTS; i++) {
+		if (wheel->levels[0][(wheel->current + i) & TIMING_WHEEL_MASK].head != NULL) {
+			earliest = wheel->current + i;
+			break;
+		}
+	}
+	// a higher level slot is cascaded when the wheel reaches the start of its range
+	for (level = 1; level < TIMING_WHEEL_LEVELS; level++) {
+		base = wheel->current >> (TIMING_WHEEL_BITS * level);
+		// the current slot is still due a cascade if the wheel sits at its start
+		first = (wheel->current & ((1L << (TIMING_WHEEL_BITS * level)) - 1)) == 0 ? 0 : 1;
+		for (i = first; i < first + TIMING_WHEEL_SLOTS; i++) {
+			if (wheel->levels[level][(base + i) & TIMING_WHEEL_MASK].head != NULL) {
+				tick = (base + i) << (TIMING_WHEEL_BITS * level);
+				if (earliest == -1 || tick < earliest) {
+					earliest = tick;
+				}
+				break;
+			}
+		}
+	}
+	return earliest;
+}
+
+timing_wheel_t
+timing_wheel_new(long now) {
+	int level, slot;
+	timing_wheel_t wheel = (timing_wheel_t)malloc(sizeof(struct timing_wheel));
+	if (wheel == NULL) {
+		fprintf(stderr, "NO MEMORY!!!\n");
+		return NULL;
+	}
+	wheel->current = now;
+	wheel->length = 0;
+	wheel->expired.head = NULL;
+	wheel->expired.tail = NULL;
+	for (level = 0; level < TIMING_WHEEL_LEVELS; level++) {
+		for (slot = 0; slot < TIMING_WHEEL_SLOTS; slot++) {
+			wheel->levels[level][slot].head = NULL;
+			wheel->levels[level][slot].tail = NULL;
+		}
+	}
+	return wheel;
+}
+
+int
+timing_wheel_insert(timing_wheel_t wheel, timing_wheel_entry_t entry) {
+	if (wheel == NULL || entry == NULL) {
+		return -1;
+	}
+	place(wheel, entry);
+	wheel->length += 1;
+	return 0;
+}
+
+int
+timing_wheel_remove(timing_wheel_t wheel, timing_wheel_entry_t entry) {
+	if (wheel == NULL || entry == NULL || entry->list == NULL) {
+		return -1;
+	}
+	list_unlink(entry->list, entry);
+	wheel->length -= 1;
+	return 0;
+}
+
+int
+timing_wheel_advance(timing_wheel_t wheel, long now) {
+	int index, level, expired;
+	long event;
+	timing_wheel_entry_t entry, next;
+
+	if (wheel == NULL) {
+		return 0;
+	}
+	expired = 0;
+	while (wheel->current <= now) {
+		// over a long span, jump straight to the next tick with work to do
+		if (now - wheel->current >= TIMING_WHEEL_SLOTS) {
+			event = next_event(wheel);
+			if (event == -1 || event > now) {
+				wheel->current = now + 1;
+				break;
+			}
+			wheel->current = event;
+		}
+		index = wheel->current & TIMING_WHEEL_MASK;
+		// level 0 wrapped, pull the next range down from the levels above
+		for (level = 1; index == 0 && level < TIMING_WHEEL_LEVELS; level++) {
+			index = cascade(wheel, level);
+		}
+		index = wheel->current & TIMING_WHEEL_MASK;
+		wheel->current += 1;
+		entry = wheel->levels[0][index].head;
+		wheel->levels[0][index].head = NULL;
+		wheel->levels[0][index].tail = NULL;
+		while (entry != NULL) {
+			next = entry->next;
+			list_append(&wheel->expired, entry);
+			expired++;
+			entry = next;
+		}
+		// empty level 0 slots before the next cascade boundary expire nothing
+		while (wheel->current <= now && (wheel->current & TIMING_WHEEL_MASK) != 0
+				&& wheel->levels[0][wheel->current & TIMING_WHEEL_MASK].head == NULL) {
+			wheel->current += 1;
+		}
+	}
+	return expired;
+}
+
+int
+timing_wheel_resync(timing_wheel_t wheel, long now) {
+	if (wheel == NULL || wheel->length != 0) {
+		return -1;
+	}
+	// never move back over ticks already processed
+	if (now > wheel->current) {
+		wheel->current = now;
+	}
+	return 0;
+}
+
+int
+timing_wheel_expired_dequeue(timing_wheel_t wheel, timing_wheel_entry_t* entry) {
+	if (wheel == NULL || wheel->expired.head == NULL) {
+		*entry = NULL;
+		return -1;
+	}
+	*entry = wheel->expired.head;
+	list_unlink(&wheel->expired, *entry);
+	wheel->length -= 1;
+	assert(wheel->length >= 0);
+	return 0;
+}
+
+long
+timing_wheel_next_expiry(timing_wheel_t wheel) {
+	if (wheel == NULL || wheel->length == 0) {
+		return -1;
+	}
+	if (wheel->expired.head != NULL) {
+		return wheel->current;
+	}
+	return next_event(wheel);
+}
+
+int
+timing_wheel_length(timing_wheel_t wheel) {
+	if (wheel == NULL) {
+		return -1;
+	}
+	return wheel->length;
+}
+
+int
+timing_wheel_free(timing_wheel_t wheel) {
+	if (wheel == NULL) {
+		return -1;
+	}
+	free(wheel);
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Hierarchical timing wheel.
+ */
+#ifndef __TIMING_WHEEL_H__
+#define __TIMING_WHEEL_H__
+
+/*
+ * The wheel has TIMING_WHEEL_LEVELS levels of TIMING_WHEEL_SLOTS slots each.
+ * Level 0 holds timers due within the next TIMING_WHEEL_SLOTS ticks, one slot
+ * per tick; every higher level covers TIMING_WHEEL_SLOTS times the range of the
+ * level below and is cascaded down as the wheel turns. Timers further out than
+ * the top level can reach are parked in its furthest slot and re-cascaded.
+ */
+#define TIMING_WHEEL_BITS 6
+#define TIMING_WHEEL_SLOTS (1 << TIMING_WHEEL_BITS)
+#define TIMING_WHEEL_MASK (TIMING_WHEEL_SLOTS - 1)
+#define TIMING_WHEEL_LEVELS 4
+
+/*
+ * A timing_wheel_entry is embedded by the client in its own timer structure,
+ * so inserting and cancelling never allocate. The client sets expires (an
+ * absolute tick) and data before inserting; the remaining fields belong to
+ * the wheel.
+ */
+typedef struct timing_wheel_entry {
+	long expires;
+	void* data;
+	struct timing_wheel_entry* prev;
+	struct timing_wheel_entry* next;
+	struct timing_wheel_list* list; // slot the entry is linked on, NULL if none
+} *timing_wheel_entry_t;
+
+typedef struct timing_wheel* timing_wheel_t;
+
+/*
+ * Return an empty wheel whose next tick to process is now. On error return NULL.
+ */
+extern timing_wheel_t timing_wheel_new(long now);
+
+/*
+ * Link entry into the wheel. An entry that is already due goes straight onto
+ * the expired list. Return 0 (success) or -1 (failure).
+ */
+extern int timing_wheel_insert(timing_wheel_t wheel, timing_wheel_entry_t entry);
+
+/*
+ * Unlink entry from the wheel or from the expired list.
+ * Return 0 (success) or -1 if the entry was not linked.
+ */
+extern int timing_wheel_remove(timing_wheel_t wheel, timing_wheel_entry_t entry);
+
+/*
+ * Turn the wheel up to and including tick now, moving every entry that falls
+ * due onto the expired list. Return the number of entries that expired.
+ */
+extern int timing_wheel_advance(timing_wheel_t wheel, long now);
+
+/*
+ * Move an empty wheel's next tick to process forward to now without turning
+ * it tick by tick, so that a wheel left idle neither pays for the skipped
+ * ticks on its next advance nor files new entries relative to a stale tick.
+ * Return 0 (success) or -1 if the wheel holds entries, which must not be
+ * skipped over.
+ */
+extern int timing_wheel_resync(timing_wheel_t wheel, long now);
+
+/*
+ * Dequeue the oldest expired entry. Return 0 (success) and the entry, or
+ * -1 (failure) and NULL if nothing has expired.
+ */
+extern int timing_wheel_expired_dequeue(timing_wheel_t wheel, timing_wheel_entry_t* entry);
+
+/*
+ * Return a tick no entry can expire before: the exact expiry when the
+ * earliest entry sits on level 0, otherwise the tick at which its higher
+ * level slot is cascaded. Returns the next tick to process if expired
+ * entries are waiting, and -1 if the wheel is empty.
+ */
+extern long timing_wheel_next_expiry(timing_wheel_t wheel);
+
+/*
+ * Return the number of entries in the wheel, expired ones included.
+ */
+extern int timing_wheel_length(timing_wheel_t wheel);
+
+/*
+ * Free the wheel and return 0 (success) or -1 (failure). Entries are owned
+ * by the client and are not freed.
+ */
+extern int timing_wheel_free(timing_wheel_t wheel);
+
+#endif __TIMING_WHEEL_H__
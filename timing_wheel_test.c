@@ -0,0 +1,195 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "timing_wheel.h"
+
+void
+test_expire_in_order() {
+	timing_wheel_t wheel = timing_wheel_new(0);
+	struct timing_wheel_entry a, b, c;
+	timing_wheel_entry_t out;
+
+	a.expires = 3;
+	b.expires = 1;
+	c.expires = 3;
+	timing_wheel_insert(wheel, &a);
+	timing_wheel_insert(wheel, &b);
+	timing_wheel_insert(wheel, &c);
+	assert(timing_wheel_length(wheel) == 3);
+	assert(timing_wheel_advance(wheel, 0) == 0);
+	assert(timing_wheel_advance(wheel, 1) == 1);
+	timing_wheel_expired_dequeue(wheel, &out);
+	assert(out == &b);
+	timing_wheel_expired_dequeue(wheel, &out);
+	assert(out == NULL);
+	// everything due on the same tick expires in one batch
+	assert(timing_wheel_advance(wheel, 3) == 2);
+	timing_wheel_expired_dequeue(wheel, &out);
+	assert(out == &a);
+	timing_wheel_expired_dequeue(wheel, &out);
+	assert(out == &c);
+	assert(timing_wheel_length(wheel) == 0);
+	timing_wheel_free(wheel);
+}
+
+void
+test_remove() {
+	timing_wheel_t wheel = timing_wheel_new(0);
+	struct timing_wheel_entry a, b;
+	timing_wheel_entry_t out;
+
+	a.expires = 5;
+	b.expires = 5;
+	timing_wheel_insert(wheel, &a);
+	timing_wheel_insert(wheel, &b);
+	assert(timing_wheel_remove(wheel, &a) == 0);
+	assert(timing_wheel_remove(wheel, &a) == -1);
+	assert(timing_wheel_advance(wheel, 5) == 1);
+	// expired entries can still be cancelled before they are dequeued
+	assert(timing_wheel_remove(wheel, &b) == 0);
+	timing_wheel_expired_dequeue(wheel, &out);
+	assert(out == NULL);
+	assert(timing_wheel_length(wheel) == 0);
+	timing_wheel_free(wheel);
+}
+
+void
+test_cascade() {
+	timing_wheel_t wheel = timing_wheel_new(10);
+	struct timing_wheel_entry entries[5];
+	long expires[5] = {100, 64, 4096 + 7, 300000, 20000000};
+	timing_wheel_entry_t out;
+	long tick;
+	int i, fired;
+
+	for (i = 0; i < 5; i++) {
+		entries[i].expires = expires[i];
+		entries[i].data = &entries[i];
+		timing_wheel_insert(wheel, &entries[i]);
+	}
+	fired = 0;
+	for (tick = 10; tick <= 20000000; tick++) {
+		if (timing_wheel_advance(wheel, tick) > 0) {
+			while (timing_wheel_expired_dequeue(wheel, &out) == 0) {
+				assert(out->expires == tick);
+				fired++;
+			}
+		}
+	}
+	assert(fired == 5);
+	timing_wheel_free(wheel);
+}
+
+void
+test_catch_up() {
+	timing_wheel_t wheel = timing_wheel_new(0);
+	struct timing_wheel_entry a, b;
+
+	a.expires = 70;
+	b.expires = 5000;
+	timing_wheel_insert(wheel, &a);
+	timing_wheel_insert(wheel, &b);
+	assert(timing_wheel_advance(wheel, 4999) == 1);
+	assert(timing_wheel_advance(wheel, 6000) == 1);
+	timing_wheel_free(wheel);
+}
+
+void
+test_skip() {
+	timing_wheel_t wheel = timing_wheel_new(10);
+	struct timing_wheel_entry entries[5];
+	long expires[5] = {100, 64, 4096 + 7, 300000, 20000000};
+	timing_wheel_entry_t out;
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		entries[i].expires = expires[i];
+		timing_wheel_insert(wheel, &entries[i]);
+	}
+	// long spans are jumped across, yet every entry still expires on time
+	assert(timing_wheel_advance(wheel, 63) == 0);
+	assert(timing_wheel_advance(wheel, 99) == 1);
+	assert(timing_wheel_advance(wheel, 299999) == 2);
+	assert(timing_wheel_advance(wheel, 300000) == 1);
+	assert(timing_wheel_advance(wheel, 19999999) == 0);
+	assert(timing_wheel_next_expiry(wheel) <= 20000000);
+	assert(timing_wheel_advance(wheel, 20000000) == 1);
+	for (i = 0; i < 5; i++) {
+		timing_wheel_expired_dequeue(wheel, &out);
+		assert(out != NULL);
+	}
+	assert(timing_wheel_length(wheel) == 0);
+	timing_wheel_free(wheel);
+}
+
+void
+test_resync() {
+	timing_wheel_t wheel = timing_wheel_new(0);
+	struct timing_wheel_entry a;
+	timing_wheel_entry_t out;
+
+	// an idle wheel jumps forward instead of turning through the gap
+	assert(timing_wheel_resync(wheel, 1L << 30) == 0);
+	a.expires = (1L << 30) + 10;
+	timing_wheel_insert(wheel, &a);
+	assert(timing_wheel_next_expiry(wheel) == (1L << 30) + 10);
+	assert(timing_wheel_advance(wheel, (1L << 30) + 9) == 0);
+	// a wheel holding entries is not moved
+	assert(timing_wheel_resync(wheel, (1L << 30) + 20) == -1);
+	assert(timing_wheel_advance(wheel, (1L << 30) + 10) == 1);
+	timing_wheel_expired_dequeue(wheel, &out);
+	assert(out == &a);
+	// nor is one moved backwards
+	assert(timing_wheel_resync(wheel, 5) == 0);
+	a.expires = 20;
+	timing_wheel_insert(wheel, &a);
+	assert(timing_wheel_next_expiry(wheel) == (1L << 30) + 11);
+	timing_wheel_free(wheel);
+}
+
+void
+test_next_expiry() {
+	timing_wheel_t wheel = timing_wheel_new(60);
+	struct timing_wheel_entry a, b;
+	long next;
+
+	assert(timing_wheel_next_expiry(wheel) == -1);
+	a.expires = 100;
+	timing_wheel_insert(wheel, &a);
+	assert(timing_wheel_next_expiry(wheel) == 100);
+	// further out than level 0: bounded by the tick its slot is cascaded at
+	b.expires = 200;
+	timing_wheel_insert(wheel, &b);
+	next = timing_wheel_next_expiry(wheel);
+	assert(next <= 100);
+	timing_wheel_remove(wheel, &a);
+	next = timing_wheel_next_expiry(wheel);
+	assert(next > 60 && next <= 200);
+	assert(timing_wheel_advance(wheel, next - 1) == 0);
+	assert(timing_wheel_advance(wheel, 200) == 1);
+	assert(timing_wheel_next_expiry(wheel) == 201);
+	timing_wheel_free(wheel);
+
+	// sitting on a level boundary whose slot has not been cascaded yet
+	wheel = timing_wheel_new(0);
+	a.expires = 64 * 64 + 5;
+	timing_wheel_insert(wheel, &a);
+	timing_wheel_advance(wheel, 64 * 64 - 1);
+	assert(timing_wheel_next_expiry(wheel) == 64 * 64);
+	timing_wheel_free(wheel);
+}
+
+int
+main() {
+	fprintf(stdout, "Testing timing_wheel\n");
+	test_expire_in_order();
+	test_remove();
+	test_cascade();
+	test_catch_up();
+	test_skip();
+	test_resync();
+	test_next_expiry();
+	fprintf(stdout, "Done!\n");
+	return 0;
+}
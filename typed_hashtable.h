@@ -0,0 +1,258 @@
+/*
+ * Type-specialized hash tables for fixed-size keys.
+ */
+#ifndef __TYPED_HASHTABLE_H__
+#define __TYPED_HASHTABLE_H__
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashtable.h"
+
+/*
+ * DEFINE_HASHTABLE(name, key_type, value_type) generates a hash table type
+ * name_t that stores keys and values by value in an open-addressing slot
+ * array, together with these functions:
+ *
+ *	int name_init(name_t* table, unsigned int size);
+ *	void name_destroy(name_t* table);
+ *	int name_get(name_t* table, const key_type* key, value_type* value);
+ *	int name_put(name_t* table, const key_type* key, value_type value);
+ *	int name_remove(name_t* table, const key_type* key, value_type* value);
+ *	int name_size(name_t* table);
+ *	int name_iterate(name_t* table,
+ *		int (*func)(void* arg, const key_type* key, value_type value), void* arg);
+ *	void name_clear(name_t* table);
+ *	int name_get_stats(name_t* table, hashtable_stats_t* stats);
+ *
+ * Unlike hashtable.h, keys are hashed and compared bytewise by code the
+ * compiler can inline, there are no hash or equality callbacks, and a lookup
+ * never allocates. key_type must therefore be a plain fixed-size type whose bytes
+ * fully determine equality (no padding, no pointers to compare through),
+ * such as a network_address_t or a port number.
+ *
+ * Functions return 0 (success) or -1 (failure) in the style of hashtable.h.
+ * get and remove store the value found through value, which may be NULL for
+ * remove. put replaces the value of a key already present. The table doubles
+ * and rehashes once live entries and tombstones fill 3/4 of it. iterate and
+ * clear behave like hashtable_iterate and hashtable_clear: func may remove
+ * the entry it is given, and returning -1 from it stops the iteration.
+ * get_stats fills in the same probe statistics as hashtable_get_stats.
+ */
+
+#define TYPED_HASHTABLE_EMPTY 0
+#define TYPED_HASHTABLE_FULL 1
+#define TYPED_HASHTABLE_TOMBSTONE 2
+#define TYPED_HASHTABLE_MIN_CAPACITY 8
+
+/*
+ * FNV-1a over the bytes of a fixed-size key.
+ */
+static __inline unsigned int
+typed_hashtable_hash(const void* key, size_t length) {
+	const unsigned char* bytes = (const unsigned char*) key;
+	unsigned int hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		hash = (hash ^ bytes[i]) * 16777619U;
+	}
+	return hash;
+}
+
+#define DEFINE_HASHTABLE(name, key_type, value_type)				\
+									\
+struct name##_slot {							\
+	key_type key;							\
+	value_type value;						\
+	unsigned char state;						\
+};									\
+									\
+typedef struct name {							\
+	struct name##_slot* slots;					\
+	unsigned int capacity; /* a power of two */			\
+	unsigned int size; /* live entries */				\
+	unsigned int used; /* live entries and tombstones */		\
+} name##_t;								\
+									\
+/* Return the slot holding key, or the slot to store it in if absent. */	\
+static __inline struct name##_slot*					\
+name##_probe(name##_t* table, const key_type* key) {			\
+	struct name##_slot* reuse = NULL;				\
+	struct name##_slot* slot;					\
+	unsigned int index, probes;					\
+									\
+	index = typed_hashtable_hash(key, sizeof(key_type)) & (table->capacity - 1); \
+	for (probes = 0; probes < table->capacity; probes++) {		\
+		slot = &table->slots[index];				\
+		if (slot->state == TYPED_HASHTABLE_EMPTY) {		\
+			return reuse != NULL ? reuse : slot;		\
+		}							\
+		if (slot->state == TYPED_HASHTABLE_TOMBSTONE) {		\
+			if (reuse == NULL) {				\
+				reuse = slot;				\
+			}						\
+		} else if (memcmp(&slot->key, key, sizeof(key_type)) == 0) { \
+			return slot;					\
+		}							\
+		index = (index + 1) & (table->capacity - 1);		\
+	}								\
+	return reuse;							\
+}									\
+									\
+static __inline int							\
+name##_alloc(name##_t* table, unsigned int capacity) {			\
+	table->capacity = TYPED_HASHTABLE_MIN_CAPACITY;			\
+	while (table->capacity < capacity) {				\
+		table->capacity *= 2;					\
+	}								\
+	table->slots = (struct name##_slot*)				\
+		calloc(table->capacity, sizeof(struct name##_slot));	\
+	table->size = 0;						\
+	table->used = 0;						\
+	return table->slots == NULL ? -1 : 0;				\
+}									\
+									\
+static __inline int							\
+name##_init(name##_t* table, unsigned int size) {			\
+	return name##_alloc(table, size * 4 / 3 + 1);			\
+}									\
+									\
+static __inline void							\
+name##_destroy(name##_t* table) {					\
+	free(table->slots);						\
+	table->slots = NULL;						\
+	table->capacity = 0;						\
+	table->size = 0;						\
+	table->used = 0;						\
+}									\
+									\
+static __inline int							\
+name##_get(name##_t* table, const key_type* key, value_type* value) {	\
+	struct name##_slot* slot = name##_probe(table, key);		\
+									\
+	if (slot == NULL || slot->state != TYPED_HASHTABLE_FULL) {	\
+		return -1;						\
+	}								\
+	*value = slot->value;						\
+	return 0;							\
+}									\
+									\
+static __inline int							\
+name##_put(name##_t* table, const key_type* key, value_type value) {	\
+	struct name##_slot* slot;					\
+	struct name##_slot* old_slots;					\
+	unsigned int old_capacity, old_size, old_used, i;		\
+									\
+	if ((table->used + 1) * 4 > table->capacity * 3) {		\
+		old_slots = table->slots;				\
+		old_capacity = table->capacity;				\
+		old_size = table->size;					\
+		old_used = table->used;					\
+		if (name##_alloc(table, table->size * 2 >= old_capacity ? \
+				old_capacity * 2 : old_capacity) == -1) { \
+			table->slots = old_slots;			\
+			table->capacity = old_capacity;			\
+			table->size = old_size;				\
+			table->used = old_used;				\
+			return -1;					\
+		}							\
+		for (i = 0; i < old_capacity; i++) {			\
+			if (old_slots[i].state == TYPED_HASHTABLE_FULL) { \
+				slot = name##_probe(table, &old_slots[i].key); \
+				*slot = old_slots[i];			\
+				table->size++;				\
+				table->used++;				\
+			}						\
+		}							\
+		free(old_slots);					\
+	}								\
+	slot = name##_probe(table, key);				\
+	if (slot->state != TYPED_HASHTABLE_FULL) {			\
+		if (slot->state == TYPED_HASHTABLE_EMPTY) {		\
+			table->used++;					\
+		}							\
+		memcpy(&slot->key, key, sizeof(key_type));		\
+		slot->state = TYPED_HASHTABLE_FULL;			\
+		table->size++;						\
+	}								\
+	slot->value = value;						\
+	return 0;							\
+}									\
+									\
+static __inline int							\
+name##_remove(name##_t* table, const key_type* key, value_type* value) { \
+	struct name##_slot* slot = name##_probe(table, key);		\
+									\
+	if (slot == NULL || slot->state != TYPED_HASHTABLE_FULL) {	\
+		return -1;						\
+	}								\
+	if (value != NULL) {						\
+		*value = slot->value;					\
+	}								\
+	slot->state = TYPED_HASHTABLE_TOMBSTONE;			\
+	table->size--;							\
+	return 0;							\
+}									\
+									\
+static __inline int							\
+name##_size(name##_t* table) {						\
+	return table->size;						\
+}									\
+									\
+static __inline int							\
+name##_iterate(name##_t* table,						\
+		int (*func)(void*, const key_type*, value_type), void* arg) { \
+	unsigned int i;							\
+									\
+	for (i = 0; i < table->capacity; i++) {				\
+		if (table->slots[i].state == TYPED_HASHTABLE_FULL &&	\
+				func(arg, &table->slots[i].key, table->slots[i].value) == -1) { \
+			return -1;					\
+		}							\
+	}								\
+	return 0;							\
+}									\
+									\
+static __inline void							\
+name##_clear(name##_t* table) {						\
+	memset(table->slots, 0, table->capacity * sizeof(struct name##_slot)); \
+	table->size = 0;						\
+	table->used = 0;						\
+}									\
+									\
+static __inline int							\
+name##_get_stats(name##_t* table, hashtable_stats_t* stats) {		\
+	unsigned int i, home, probe;					\
+	unsigned long total_probe;					\
+									\
+	if (table == NULL || stats == NULL) {				\
+		return -1;						\
+	}								\
+	total_probe = 0;						\
+	stats->size = table->size;					\
+	stats->capacity = table->capacity;				\
+	stats->load_factor = table->capacity > 0 ?			\
+		(double) table->size / table->capacity : 0;		\
+	stats->max_probe = 0;						\
+	stats->collisions = 0;						\
+	for (i = 0; i < table->capacity; i++) {				\
+		if (table->slots[i].state != TYPED_HASHTABLE_FULL) {	\
+			continue;					\
+		}							\
+		home = typed_hashtable_hash(&table->slots[i].key, sizeof(key_type)) & \
+			(table->capacity - 1);				\
+		probe = ((i - home) & (table->capacity - 1)) + 1;	\
+		total_probe += probe;					\
+		if (probe > stats->max_probe) {				\
+			stats->max_probe = probe;			\
+		}							\
+		if (probe > 1) {					\
+			stats->collisions++;				\
+		}							\
+	}								\
+	stats->avg_probe = table->size > 0 ? (double) total_probe / table->size : 0; \
+	return 0;							\
+}
+
+#endif __TYPED_HASHTABLE_H__
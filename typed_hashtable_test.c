@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include "typed_hashtable.h"
+
+typedef unsigned int address_t[2];
+
+DEFINE_HASHTABLE(port_table, unsigned short, int)
+DEFINE_HASHTABLE(address_table, address_t, int)
+
+void
+test_put_get() {
+    port_table_t table;
+    unsigned short port;
+    int value;
+
+    assert(port_table_init(&table, 4) == 0);
+    port = 80;
+    assert(port_table_put(&table, &port, 1) == 0);
+    port = 443;
+    assert(port_table_put(&table, &port, 2) == 0);
+    assert(port_table_get(&table, &port, &value) == 0);
+    assert(value == 2);
+    port = 80;
+    assert(port_table_get(&table, &port, &value) == 0);
+    assert(value == 1);
+    // put replaces the value of a key already present
+    assert(port_table_put(&table, &port, 3) == 0);
+    assert(port_table_size(&table) == 2);
+    assert(port_table_get(&table, &port, &value) == 0);
+    assert(value == 3);
+    port = 22;
+    assert(port_table_get(&table, &port, &value) == -1);
+    port_table_destroy(&table);
+}
+
+void
+test_array_keys() {
+    address_table_t table;
+    address_t address;
+    int value, i;
+
+    assert(address_table_init(&table, 1) == 0);
+    for (i = 0; i < 500; i++) {
+        address[0] = 0x0a000000 + i;
+        address[1] = 8000 + i % 3;
+        assert(address_table_put(&table, &address, i) == 0);
+    }
+    assert(address_table_size(&table) == 500);
+    for (i = 0; i < 500; i += 2) {
+        address[0] = 0x0a000000 + i;
+        address[1] = 8000 + i % 3;
+        assert(address_table_remove(&table, &address, &value) == 0);
+        assert(value == i);
+    }
+    // keys are compared by value, not by where they are stored
+    for (i = 0; i < 500; i++) {
+        address[0] = 0x0a000000 + i;
+        address[1] = 8000 + i % 3;
+        assert(address_table_get(&table, &address, &value) == (i % 2 ? 0 : -1));
+    }
+    assert(address_table_size(&table) == 250);
+    address_table_destroy(&table);
+}
+
+int
+remove_odd(port_table_t *table, const unsigned short *port, int value) {
+    if (value % 2) {
+        port_table_remove(table, port, NULL);
+    }
+    return 0;
+}
+
+void
+test_iterate_clear() {
+    port_table_t table;
+    unsigned short port;
+    int value;
+
+    assert(port_table_init(&table, 4) == 0);
+    for (port = 1; port <= 10; port++) {
+        assert(port_table_put(&table, &port, port) == 0);
+    }
+    assert(port_table_iterate(&table, (int (*)(void*, const unsigned short*, int)) remove_odd, &table) == 0);
+    assert(port_table_size(&table) == 5);
+    port = 3;
+    assert(port_table_get(&table, &port, &value) == -1);
+    port = 4;
+    assert(port_table_get(&table, &port, &value) == 0);
+    port_table_clear(&table);
+    assert(port_table_size(&table) == 0);
+    assert(port_table_get(&table, &port, &value) == -1);
+    port_table_destroy(&table);
+}
+
+void
+test_stats() {
+    port_table_t table;
+    hashtable_stats_t stats;
+    unsigned short port;
+
+    assert(port_table_init(&table, 16) == 0);
+    assert(port_table_get_stats(&table, &stats) == 0);
+    assert(stats.size == 0 && stats.max_probe == 0 && stats.avg_probe == 0);
+    for (port = 1; port <= 12; port++) {
+        assert(port_table_put(&table, &port, port) == 0);
+    }
+    assert(port_table_get_stats(&table, &stats) == 0);
+    assert(stats.size == 12);
+    assert(stats.capacity == table.capacity);
+    assert(stats.max_probe >= 1 && stats.avg_probe >= 1);
+    assert(stats.avg_probe <= stats.max_probe);
+    // every entry beyond its home slot is a collision
+    assert((stats.collisions == 0) == (stats.max_probe == 1));
+    port_table_destroy(&table);
+}
+
+int
+main() {
+    printf("Testing typed hash table...\n");
+    test_put_get();
+    test_array_keys();
+    test_iterate_clear();
+    test_stats();
+    printf("Testing done!\n");
+    return 0;
+}
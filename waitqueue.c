@@ -0,0 +1,173 @@
+/*
+ * Keyed wait queue implementation.
+ *
+ * Every bucket is an intrusive list of the wait nodes of the threads parked
+ * on keys that hash to it, in the order they started waiting. Threads waiting
+ * on different keys may share a bucket, so waking compares keys.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "interrupts.h"
+#include "alarm.h"
+#include "waitqueue.h"
+
+struct waitqueue_bucket {
+	waitqueue_node_t head;
+	waitqueue_node_t tail;
+};
+
+struct waitqueue_bucket waitqueue_buckets[WAITQUEUE_BUCKETS];
+
+static struct waitqueue_bucket*
+bucket_of(void* key) {
+	unsigned long hash;
+
+	// the low bits of an address carry little information
+	hash = ((unsigned long)key >> 3) * 2654435761UL;
+	return &waitqueue_buckets[(hash >> 16) & (WAITQUEUE_BUCKETS - 1)];
+}
+
+static void
+bucket_append(struct waitqueue_bucket* bucket, waitqueue_node_t node) {
+	node->bucket = bucket;
+	node->next = NULL;
+	node->prev = bucket->tail;
+	if (bucket->tail == NULL) {
+		bucket->head = node;
+	} else {
+		bucket->tail->next = node;
+	}
+	bucket->tail = node;
+}
+
+static void
+bucket_unlink(waitqueue_node_t node) {
+	struct waitqueue_bucket* bucket = node->bucket;
+
+	if (node->prev == NULL) {
+		bucket->head = node->next;
+	} else {
+		node->prev->next = node->next;
+	}
+	if (node->next == NULL) {
+		bucket->tail = node->prev;
+	} else {
+		node->next->prev = node->prev;
+	}
+	node->prev = NULL;
+	node->next = NULL;
+	node->bucket = NULL;
+}
+
+/*
+ * Unlink a waiting thread, cancel its timeout and make it runnable.
+ * Must be called with interrupts disabled.
+ */
+static void
+release(waitqueue_node_t node, int timed_out) {
+	bucket_unlink(node);
+	waitqueue_disarm_timeout(node);
+	node->key = NULL;
+	node->timed_out = timed_out;
+	minithread_start(node->thread);
+}
+
+static void
+expire_wait(waitqueue_node_t node) {
+	release(node, 1);
+}
+
+/*
+ * Alarm handler for every armed timeout. The alarm slot is freed before this
+ * runs, so the wait it was armed for may already be over and the thread may
+ * be waiting again. Only the current wait's timeout is acted on, and only
+ * once its deadline has passed.
+ */
+static int
+node_timeout(waitqueue_node_t node) {
+	void (*expire)(waitqueue_node_t);
+	interrupt_level_t level;
+
+	level = set_interrupt_level(DISABLED);
+	if (node->deadline != -1 && ticks >= node->deadline) {
+		expire = node->expire;
+		node->alarm_id = -1;
+		node->deadline = -1;
+		node->expire = NULL;
+		expire(node);
+	}
+	set_interrupt_level(level);
+	return 0;
+}
+
+void
+waitqueue_node_init(waitqueue_node_t node, minithread_t thread) {
+	node->key = NULL;
+	node->thread = thread;
+	node->alarm_id = -1;
+	node->deadline = -1;
+	node->expire = NULL;
+	node->timed_out = 0;
+	node->prev = NULL;
+	node->next = NULL;
+	node->bucket = NULL;
+}
+
+int
+waitqueue_arm_timeout(waitqueue_node_t node, int timeout, void (*expire)(waitqueue_node_t)) {
+	node->alarm_id = register_alarm(timeout, (proc_t)node_timeout, (arg_t)node);
+	if (node->alarm_id == -1) {
+		return -1;
+	}
+	node->deadline = alarm_get_expiry(node->alarm_id);
+	node->expire = expire;
+	return 0;
+}
+
+void
+waitqueue_disarm_timeout(waitqueue_node_t node) {
+	deregister_alarm(node->alarm_id);
+	node->alarm_id = -1;
+	node->deadline = -1;
+	node->expire = NULL;
+}
+
+int
+waitqueue_wait(void* key, int timeout) {
+	waitqueue_node_t node;
+
+	node = minithread_wait_node(minithread_self());
+	node->key = key;
+	node->timed_out = 0;
+	bucket_append(bucket_of(key), node);
+	// without a timer the wait could never end, give up at once
+	if (timeout >= 0 && waitqueue_arm_timeout(node, timeout, expire_wait) == -1) {
+		bucket_unlink(node);
+		node->key = NULL;
+		return 1;
+	}
+	minithread_unlock_and_stop(NULL);
+	return node->timed_out;
+}
+
+int
+waitqueue_wake(void* key, int count) {
+	waitqueue_node_t node, next;
+	interrupt_level_t level;
+	int woken;
+
+	woken = 0;
+	level = set_interrupt_level(DISABLED);
+	node = bucket_of(key)->head;
+	while (node != NULL && woken != count) {
+		next = node->next;
+		if (node->key == key) {
+			release(node, 0);
+			woken++;
+		}
+		node = next;
+	}
+	set_interrupt_level(level);
+	return woken;
+}
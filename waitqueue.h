@@ -0,0 +1,71 @@
+/*
+ * Keyed wait queues.
+ */
+#ifndef __WAITQUEUE_H__
+#define __WAITQUEUE_H__
+
+#include "minithread.h"
+
+/*
+ * Threads park on an arbitrary address (the key) and are woken by whoever
+ * changes the state behind that address, in the style of futexes. The wait
+ * queues live in one global hash table, so nothing has to be allocated to
+ * wait on an object: each thread carries a single waitqueue_node (see
+ * minithread_wait_node) and a timed wait uses one alarm slot.
+ */
+#define WAITQUEUE_BUCKETS 64
+
+/*
+ * Wait state embedded in every thread. The wait queue owns it, and other
+ * blocking primitives borrow its timeout (see waitqueue_arm_timeout).
+ */
+typedef struct waitqueue_node {
+	void* key;
+	minithread_t thread;
+	int alarm_id;
+	long deadline; // tick the timeout alarm is due, -1 if none
+	void (*expire)(struct waitqueue_node*); // called when the timeout passes
+	int timed_out;
+	struct waitqueue_node* prev;
+	struct waitqueue_node* next;
+	struct waitqueue_bucket* bucket; // bucket the node is linked on, NULL if none
+} *waitqueue_node_t;
+
+/*
+ * Prepare the wait node of a newly created thread.
+ */
+extern void waitqueue_node_init(waitqueue_node_t node, minithread_t thread);
+
+/*
+ * Arrange for expire(node) to be called, with interrupts disabled, once
+ * timeout milliseconds have passed, unless the timeout is disarmed first.
+ * The wait's owner sets key before arming. Return 0 (success) or -1 if
+ * no alarm could be registered.
+ *
+ * Must be called with interrupts disabled.
+ */
+extern int waitqueue_arm_timeout(waitqueue_node_t node, int timeout, void (*expire)(waitqueue_node_t));
+
+/*
+ * Cancel a pending timeout. Harmless if it is not armed.
+ * Must be called with interrupts disabled.
+ */
+extern void waitqueue_disarm_timeout(waitqueue_node_t node);
+
+/*
+ * Block the calling thread on key until waitqueue_wake wakes it or timeout
+ * milliseconds pass. A negative timeout waits forever. Return 1 if the wait
+ * timed out and 0 if the thread was woken.
+ *
+ * Must be called with interrupts disabled, so that the caller's check of its
+ * condition and the wait are atomic. Interrupts are disabled again on return.
+ */
+extern int waitqueue_wait(void* key, int timeout);
+
+/*
+ * Wake up to count threads waiting on key, oldest first. A negative count
+ * wakes them all. Return the number of threads woken.
+ */
+extern int waitqueue_wake(void* key, int count);
+
+#endif __WAITQUEUE_H__